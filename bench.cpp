@@ -0,0 +1,237 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <vector>
+#include "board.h"
+#include "player.h"
+#include "playout.h"
+
+/*
+ * Search benchmark: runs negascout to a fixed depth on a suite of positions
+ * once for each combination of the selective search techniques, and reports
+ * the nodes and time each needs and how often it still finds the best move.
+ *
+ *   bench [--positions file] [--count N] [--empties E] [--depth D] [--seed S]
+ *         [--multipv K] [--eval-cache entries]
+ *
+ * Without a position file the suite is made of positions reached by seeded
+ * random games with E empty squares left. A position file has one position
+ * per line in the FFO style: 64 squares ('X', 'b' or '*' for black, 'O'
+ * or 'w' for white, anything else empty, a1 b1 ... h8), the side to move,
+ * and optionally ';' and the best move ("g8"). Where no best move is given
+ * the move found with every technique switched off counts as the best.
+ *
+ * With --multipv the suite is also searched by iterative deepening with
+ * the default settings for the best move and for the best K, to compare
+ * what the extra lines cost.
+ *
+ * With --eval-cache each configuration searches with an evaluation cache of
+ * that many entries, started empty, and its hit rate is reported too.
+ */
+
+struct BenchPosition
+{
+	uint64_t black, white;
+	Side toMove;
+	int best;
+};
+
+struct BenchConfig
+{
+	const char *name;
+	bool lmr, futility, razoring, lazy;
+};
+
+static const BenchConfig CONFIGS[] = {
+	{"none", false, false, false, false},
+	{"lmr", true, false, false, false},
+	{"futility", false, true, false, false},
+	{"razoring", false, false, true, false},
+	{"lazy", false, false, false, true},
+	{"exact", true, true, true, false},
+	{"all", true, true, true, true}
+};
+static const int NUM_CONFIGS = sizeof(CONFIGS) / sizeof(CONFIGS[0]);
+
+/*
+ * Parses one line of a position file, returning false if it holds none.
+ */
+static bool parsePosition(const char *line, BenchPosition *pos) {
+	int squares = 0;
+	pos->black = pos->white = 0;
+	for (; *line && squares < 64; line++) {
+		if (*line == ' ' || *line == '\t') continue;
+		if (strchr("Xxb*", *line)) pos->black |= 1ULL << squares;
+		else if (strchr("Oow", *line)) pos->white |= 1ULL << squares;
+		squares++;
+	}
+	while (*line == ' ' || *line == '\t') line++;
+	if (squares < 64 || !*line) return false;
+	pos->toMove = strchr("Xxb*", *line) ? BLACK : WHITE;
+	pos->best = -1;
+	const char *rest = strchr(line, ';');
+	if (rest != NULL) {
+		rest++;
+		while (*rest == ' ') rest++;
+		int x = (rest[0] | 0x20) - 'a', y = rest[1] - '1';
+		if (x >= 0 && x < 8 && y >= 0 && y < 8) pos->best = x + 8*y;
+	}
+	return true;
+}
+
+/*
+ * Plays seeded random games until count positions with the given number of
+ * empty squares and a move for the side to move have been collected.
+ */
+static void randomPositions(std::vector<BenchPosition> &suite, int count, int empties, uint64_t seed) {
+	Xorshift rng(seed);
+	while ((int) suite.size() < count) {
+		uint64_t me = 0x0000000810000000ULL, opp = 0x0000001008000000ULL;
+		Side side = BLACK;
+		int passes = 0;
+		while (passes < 2 && 64 - popcount(me | opp) > empties) {
+			uint64_t moves = moveMask(me, opp);
+			if (moves) {
+				int sq = selectBit(moves, rng.below(popcount(moves)));
+				uint64_t flips = flipMask(sq, me, opp);
+				me |= flips | (1ULL << sq);
+				opp &= ~flips;
+				passes = 0;
+			}
+			else passes++;
+			uint64_t t = me;
+			me = opp;
+			opp = t;
+			side = (side == BLACK) ? WHITE : BLACK;
+		}
+		if (64 - popcount(me | opp) != empties || moveMask(me, opp) == 0) continue;
+		BenchPosition pos;
+		pos.black = (side == BLACK) ? me : opp;
+		pos.white = (side == BLACK) ? opp : me;
+		pos.toMove = side;
+		pos.best = -1;
+		suite.push_back(pos);
+	}
+}
+
+/*
+ * Searches one position with a fresh board, returning the move found and
+ * adding the nodes visited to nodes.
+ */
+static int search(const BenchPosition &pos, const SearchParams &params, int depth, long *nodes,
+	EvalCache *evalCache, long *probes, long *hits) {
+	Board board(pos.toMove);
+	board.setPosition(pos.black, pos.white);
+	board.params = params;
+	board.evalCache = evalCache;
+	board.moves.push(-5);
+	board.moveToDo->setX(-1);
+	board.moveToDo->setY(-1);
+	board.negascout(depth, -100000000, 100000000, 1, true, true, 0);
+	*nodes += board.nodes;
+	*probes += board.evalProbes;
+	*hits += board.evalHits;
+	return board.moveToDo->getX() + 8*board.moveToDo->getY();
+}
+
+static void usage(const char *name) {
+	fprintf(stderr, "usage: %s [--positions file] [--count N] [--empties E] [--depth D] [--seed S]\n"
+		"    [--multipv K] [--eval-cache entries]\n", name);
+	exit(-1);
+}
+
+int main(int argc, char *argv[]) {
+	const char *positionFile = NULL;
+	int count = 50, empties = 30, depth = 8, multiPv = 0, evalCacheSize = 0;
+	uint64_t seed = 1;
+	for (int i = 1; i < argc; i += 2) {
+		if (i + 1 >= argc) usage(argv[0]);
+		if (!strcmp(argv[i], "--positions")) positionFile = argv[i + 1];
+		else if (!strcmp(argv[i], "--count")) count = atoi(argv[i + 1]);
+		else if (!strcmp(argv[i], "--empties")) empties = atoi(argv[i + 1]);
+		else if (!strcmp(argv[i], "--depth")) depth = atoi(argv[i + 1]);
+		else if (!strcmp(argv[i], "--seed")) seed = strtoull(argv[i + 1], NULL, 10);
+		else if (!strcmp(argv[i], "--multipv")) multiPv = atoi(argv[i + 1]);
+		else if (!strcmp(argv[i], "--eval-cache")) evalCacheSize = atoi(argv[i + 1]);
+		else usage(argv[0]);
+	}
+
+	std::vector<BenchPosition> suite;
+	if (positionFile != NULL) {
+		FILE *in = fopen(positionFile, "r");
+		if (in == NULL) {
+			fprintf(stderr, "cannot open %s\n", positionFile);
+			return 1;
+		}
+		char line[256];
+		BenchPosition pos;
+		while (fgets(line, sizeof(line), in) != NULL)
+			if (parsePosition(line, &pos)) suite.push_back(pos);
+		fclose(in);
+	}
+	else randomPositions(suite, count, empties, seed);
+	if (suite.empty()) {
+		fprintf(stderr, "no positions to search\n");
+		return 1;
+	}
+	printf("%d positions, depth %d\n", (int) suite.size(), depth);
+	printf("%-10s %12s %8s %10s %12s %8s", "config", "nodes", "vs none", "seconds", "nodes/s", "solved");
+	if (evalCacheSize > 0) printf(" %9s", "eval hits");
+	printf("\n");
+	EvalCache *evalCache = (evalCacheSize > 0) ? new EvalCache(evalCacheSize) : NULL;
+
+	long baseNodes = 0;
+	std::vector<int> reference(suite.size());
+	for (int c = 0; c < NUM_CONFIGS; c++) {
+		SearchParams params;
+		params.lateMoveReductions = CONFIGS[c].lmr;
+		params.futility = CONFIGS[c].futility;
+		params.razoring = CONFIGS[c].razoring;
+		params.lazyEval = CONFIGS[c].lazy;
+
+		long nodes = 0, probes = 0, hits = 0;
+		int solved = 0;
+		if (evalCache != NULL) evalCache->clear();
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < suite.size(); i++) {
+			int move = search(suite[i], params, depth, &nodes, evalCache, &probes, &hits);
+			// The first configuration searches everything, so it supplies
+			// the best moves the file does not
+			if (c == 0) reference[i] = (suite[i].best >= 0) ? suite[i].best : move;
+			if (move == reference[i]) solved++;
+		}
+		std::chrono::duration<double> spent = std::chrono::steady_clock::now() - start;
+		if (c == 0) baseNodes = nodes;
+		printf("%-10s %12ld %7.1f%% %10.3f %12.0f %7.1f%%", CONFIGS[c].name, nodes,
+			100.0 * nodes / baseNodes, spent.count(), nodes / spent.count(), 100.0 * solved / suite.size());
+		if (evalCache != NULL) printf(" %8.1f%%", probes > 0 ? 100.0 * hits / probes : 0.0);
+		printf("\n");
+		fflush(stdout);
+	}
+
+	if (multiPv > 1) {
+		SearchLimits limits;
+		limits.depth = depth;
+		SearchInfo lines[64];
+		long nodes[2] = {0, 0};
+		double seconds[2] = {0, 0};
+		for (int run = 0; run < 2; run++) {
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			for (size_t i = 0; i < suite.size(); i++) {
+				Player player(suite[i].toMove);
+				player.setPosition(suite[i].black, suite[i].white);
+				int found = player.searchLines(limits, (run == 0) ? 1 : multiPv, lines, NULL, NULL);
+				if (found > 0) nodes[run] += lines[found - 1].nodes;
+			}
+			std::chrono::duration<double> spent = std::chrono::steady_clock::now() - start;
+			seconds[run] = spent.count();
+		}
+		printf("multi-pv, iterative deepening to depth %d:\n", depth);
+		printf("  1 line   %12ld nodes %10.3f s\n", nodes[0], seconds[0]);
+		printf("  %d lines  %12ld nodes %10.3f s  (%.2f times one line)\n", multiPv, nodes[1], seconds[1],
+			(double) nodes[1] / nodes[0]);
+	}
+	delete evalCache;
+	return 0;
+}
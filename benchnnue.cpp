@@ -0,0 +1,184 @@
+#include <cstdio>
+#include <cstdlib>
+#include <climits>
+#include <chrono>
+#include <vector>
+#include "eval.h"
+#include "nnue.h"
+#include "playout.h"
+#include "board.h"
+
+/*
+ * Compares evaluations per second of the weighted feature evaluation, one
+ * position at a time and in batches, and the network, both summed from scratch and updated incrementally the way
+ * the search does it (play a move, evaluate, take it back).
+ *
+ *   benchnnue [network file] [evaluations]
+ *
+ * Without a network file a randomly weighted network is used, which costs
+ * exactly the same to run.
+ *
+ * First it checks that the accumulator a board keeps up to date through
+ * doMove and undoMove always equals one summed afresh, and fails if not.
+ */
+
+struct Sample
+{
+	uint64_t me, opp;
+	Side side;
+	int square;
+	uint64_t flips;
+};
+
+/*
+ * Walks a board through random games, playing a random move or taking one
+ * back at each step (and passing when there is no move), and compares its
+ * accumulator with a refresh after every step. Returns the number of steps
+ * where they differed.
+ */
+static int checkAccumulator(const Network *network, int games) {
+	Xorshift rng(7);
+	int bad = 0;
+	for (int g = 0; g < games; g++) {
+		Board board(BLACK);
+		board.setNetwork(network);
+		// Who played each move still on the board
+		Side played[64];
+		int numPlayed = 0, passes = 0;
+		Side side = BLACK;
+		while (passes < 2) {
+			// Now and then take the last move back, as the search does
+			if (numPlayed > 0 && rng.below(3) == 0) {
+				board.undoMove();
+				side = played[--numPlayed];
+				passes = 0;
+			}
+			else {
+				int list[64];
+				int numMoves = board.getMoves(side, list);
+				if (numMoves == 0) passes++;
+				else {
+					int square = list[rng.below(numMoves)];
+					Move move(square%8, square/8);
+					board.doMove(&move, side);
+					played[numPlayed++] = side;
+					passes = 0;
+				}
+				side = (side == BLACK) ? WHITE : BLACK;
+			}
+			if (!board.accumulatorMatches()) bad++;
+		}
+	}
+	return bad;
+}
+
+static double seconds(std::chrono::steady_clock::time_point start) {
+	std::chrono::duration<double> spent = std::chrono::steady_clock::now() - start;
+	return spent.count();
+}
+
+int main(int argc, char *argv[]) {
+	Network *network = new Network();
+	if (argc > 1 && !network->load(argv[1])) {
+		fprintf(stderr, "cannot load network from %s\n", argv[1]);
+		exit(-1);
+	}
+	if (argc <= 1) network->randomize(1);
+	long count = (argc > 2) ? atol(argv[2]) : 2000000;
+
+	int wrong = checkAccumulator(network, 200);
+	if (wrong > 0) {
+		printf("incremental accumulator differs from a refresh at %d steps\n", wrong);
+		return 1;
+	}
+	printf("incremental accumulator matches a refresh in 200 random games\n");
+
+	// Positions from random games, each with a legal move to try
+	std::vector<Sample> samples;
+	Xorshift rng(99);
+	while (samples.size() < 4096) {
+		uint64_t me = 0x0000000810000000ULL, opp = 0x0000001008000000ULL;
+		Side side = BLACK;
+		for (int ply = 0; ply < 60; ply++) {
+			uint64_t moves = moveMask(me, opp);
+			if (moves == 0) break;
+			int sq = selectBit(moves, rng.below(popcount(moves)));
+			Sample s = {me, opp, side, sq, flipMask(sq, me, opp)};
+			samples.push_back(s);
+			me |= s.flips | (1ULL << sq);
+			opp &= ~s.flips;
+			uint64_t t = me;
+			me = opp;
+			opp = t;
+			side = (side == BLACK) ? WHITE : BLACK;
+		}
+	}
+	int n = samples.size();
+
+	const EvalWeights *weights = standardWeights();
+	long total = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (long i = 0; i < count; i++) total += evaluate(weights, samples[i % n].me, samples[i % n].opp);
+	double features = seconds(start);
+
+	// The same positions scored in batches the size of a typical move list
+	std::vector<uint64_t> mine(n), theirs(n);
+	for (int i = 0; i < n; i++) {
+		mine[i] = samples[i].me;
+		theirs[i] = samples[i].opp;
+	}
+	std::vector<int> batchScores(n);
+	evaluateBatch(weights, mine.data(), theirs.data(), n, INT_MIN, INT_MAX, batchScores.data());
+	int mismatches = 0;
+	for (int i = 0; i < n; i++) mismatches += batchScores[i] != evaluate(weights, mine[i], theirs[i]);
+	const int BATCH = 10;
+	start = std::chrono::steady_clock::now();
+	for (long i = 0; i < count; i += BATCH) {
+		int at = (int) (i % (n - BATCH));
+		evaluateBatch(weights, &mine[at], &theirs[at], BATCH, INT_MIN, INT_MAX, &batchScores[at]);
+		total += batchScores[at];
+	}
+	double batched = seconds(start);
+
+	Accumulator acc;
+	start = std::chrono::steady_clock::now();
+	for (long i = 0; i < count; i++) {
+		const Sample &s = samples[i % n];
+		uint64_t black = (s.side == BLACK) ? s.me : s.opp;
+		uint64_t white = (s.side == BLACK) ? s.opp : s.me;
+		network->refresh(&acc, black, white);
+		total += network->evaluate(&acc, s.side);
+	}
+	double refreshed = seconds(start);
+
+	start = std::chrono::steady_clock::now();
+	for (long i = 0; i < count; i++) {
+		const Sample &s = samples[i % n];
+		Side other = (s.side == BLACK) ? WHITE : BLACK;
+		// Play the move into the accumulator, evaluate, take it back
+		network->add(&acc, s.square, s.side);
+		for (uint64_t f = s.flips; f; f &= f - 1) {
+			network->remove(&acc, __builtin_ctzll(f), other);
+			network->add(&acc, __builtin_ctzll(f), s.side);
+		}
+		total += network->evaluate(&acc, other);
+		for (uint64_t f = s.flips; f; f &= f - 1) {
+			network->remove(&acc, __builtin_ctzll(f), s.side);
+			network->add(&acc, __builtin_ctzll(f), other);
+		}
+		network->remove(&acc, s.square, s.side);
+	}
+	double incremental = seconds(start);
+
+	printf("betterHeuristic features  %12.0f evals/s\n", count / features);
+	printf("features, batches of %d   %12.0f evals/s (%d mismatches)\n", BATCH, count / batched, mismatches);
+	printf("network, full refresh     %12.0f evals/s\n", count / refreshed);
+	printf("network, incremental      %12.0f evals/s (move, evaluate, undo)\n", count / incremental);
+#ifdef __AVX2__
+	printf("network kernels: avx2 (checksum %ld)\n", total);
+#else
+	printf("network kernels: scalar, build with make ARCH=-march=native for avx2 (checksum %ld)\n", total);
+#endif
+	delete network;
+	return 0;
+}
@@ -0,0 +1,49 @@
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include "playout.h"
+
+/*
+ * Measures how many random playouts per second one core manages, from the
+ * starting position and from a midgame position reached by random moves.
+ */
+static void bench(const char *name, uint64_t me, uint64_t opp, long count, bool preferCorners) {
+	Xorshift rng(12345);
+	long total = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (long i = 0; i < count; i++) total += playout(me, opp, rng, preferCorners);
+	std::chrono::duration<double> spent = std::chrono::steady_clock::now() - start;
+	printf("%-24s %10ld playouts %8.3f s %12.0f playouts/s (mean result %+.2f)\n", name, count,
+		spent.count(), count / spent.count(), (double) total / count);
+}
+
+int main(int argc, char *argv[]) {
+	long count = (argc > 1) ? atol(argv[1]) : 1000000;
+	// Black to move in the starting position
+	uint64_t black = 0x0000000810000000ULL, white = 0x0000001008000000ULL;
+	bench("start", black, white, count, false);
+	bench("start, corners first", black, white, count, true);
+
+	// Twenty random moves in
+	Xorshift rng(7);
+	uint64_t me = black, opp = white;
+	for (int i = 0; i < 20; i++) {
+		uint64_t moves = moveMask(me, opp);
+		if (moves) {
+			int sq = selectBit(moves, rng.below(popcount(moves)));
+			uint64_t flips = flipMask(sq, me, opp);
+			me |= flips | (1ULL << sq);
+			opp &= ~flips;
+		}
+		uint64_t t = me;
+		me = opp;
+		opp = t;
+	}
+	bench("midgame", me, opp, count, false);
+#ifdef __BMI2__
+	printf("bit select: pdep\n");
+#else
+	printf("bit select: loop (build with make ARCH=-march=native for pdep)\n");
+#endif
+	return 0;
+}
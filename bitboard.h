@@ -0,0 +1,121 @@
+#ifndef __BITBOARD_H__
+#define __BITBOARD_H__
+
+#include <cstdint>
+
+/*
+ * Helpers for working on a whole board at once. Square x, y is bit x + y*8
+ * of a uint64_t, the same layout Board uses for blackb and takenb.
+ */
+
+// Squares with x == 0 and with x == 7
+#define FILE_A 0x0101010101010101ULL
+#define FILE_H 0x8080808080808080ULL
+
+// The 8 directions, numbered as used by shiftDir
+enum Direction {
+	DIR_E, DIR_W, DIR_S, DIR_N, DIR_SE, DIR_SW, DIR_NE, DIR_NW
+};
+
+/*
+ * Moves every stone of b one square in direction d, dropping the ones that
+ * fall off the board.
+ */
+inline uint64_t shiftDir(uint64_t b, int d) {
+	switch (d) {
+		case DIR_E: return (b << 1) & ~FILE_A;
+		case DIR_W: return (b >> 1) & ~FILE_H;
+		case DIR_S: return b << 8;
+		case DIR_N: return b >> 8;
+		case DIR_SE: return (b << 9) & ~FILE_A;
+		case DIR_SW: return (b << 7) & ~FILE_H;
+		case DIR_NE: return (b >> 7) & ~FILE_A;
+		default: return (b >> 9) & ~FILE_H;
+	}
+}
+
+/*
+ * Every square next to a stone of b, in any direction.
+ */
+inline uint64_t neighbours(uint64_t b) {
+	uint64_t sideways = ((b << 1) & ~FILE_A) | ((b >> 1) & ~FILE_H);
+	uint64_t row = b | sideways;
+	return sideways | (row << 8) | (row >> 8);
+}
+
+inline int popcount(uint64_t b) {
+	return __builtin_popcountll(b);
+}
+
+// Opponent stones a horizontal or diagonal run can pass through: not on
+// the first or last column, so runs never wrap from one row to the next
+#define INNER_COLUMNS 0x7E7E7E7E7E7E7E7EULL
+
+/*
+ * Squares reached from me by a run of opp stones along one line, shifting
+ * by dir each step (left for the run's first half, right for the other).
+ * The runs are grown in parallel prefix style: two single steps, then two
+ * double steps, which covers the longest possible run of six.
+ */
+inline uint64_t movesAlong(uint64_t me, uint64_t opp, int dir) {
+	uint64_t left = opp & (me << dir);
+	left |= opp & (left << dir);
+	uint64_t preLeft = opp & (opp << dir);
+	left |= preLeft & (left << (2*dir));
+	left |= preLeft & (left << (2*dir));
+
+	uint64_t right = opp & (me >> dir);
+	right |= opp & (right >> dir);
+	uint64_t preRight = opp & (opp >> dir);
+	right |= preRight & (right >> (2*dir));
+	right |= preRight & (right >> (2*dir));
+
+	return (left << dir) | (right >> dir);
+}
+
+/*
+ * All squares where the player owning me may legally move.
+ */
+inline uint64_t moveMask(uint64_t me, uint64_t opp) {
+	uint64_t inner = opp & INNER_COLUMNS;
+	uint64_t moves = movesAlong(me, inner, 1) | movesAlong(me, opp, 8) |
+		movesAlong(me, inner, 7) | movesAlong(me, inner, 9);
+	return moves & ~(me | opp);
+}
+
+/*
+ * The stones of opp turned over along one line when me plays on the square
+ * start, shifting by dir.
+ */
+inline uint64_t flipsAlong(uint64_t start, uint64_t me, uint64_t opp, int dir) {
+	uint64_t flips = 0;
+	uint64_t run = opp & (start << dir);
+	run |= opp & (run << dir);
+	run |= opp & (run << dir);
+	run |= opp & (run << dir);
+	run |= opp & (run << dir);
+	run |= opp & (run << dir);
+	// The run only counts if one of our stones closes it
+	flips |= run & (0 - (uint64_t) (((run << dir) & me) != 0));
+
+	run = opp & (start >> dir);
+	run |= opp & (run >> dir);
+	run |= opp & (run >> dir);
+	run |= opp & (run >> dir);
+	run |= opp & (run >> dir);
+	run |= opp & (run >> dir);
+	flips |= run & (0 - (uint64_t) (((run >> dir) & me) != 0));
+	return flips;
+}
+
+/*
+ * The opponent stones turned over when me plays on square sq.
+ */
+inline uint64_t flipMask(int sq, uint64_t me, uint64_t opp) {
+	uint64_t start = 1ULL << sq;
+	uint64_t inner = opp & INNER_COLUMNS;
+	return flipsAlong(start, me, inner, 1) | flipsAlong(start, me, opp, 8) |
+		flipsAlong(start, me, inner, 7) | flipsAlong(start, me, inner, 9);
+}
+
+#endif
@@ -1,4 +1,8 @@
+#include <cstdio>
+#include <cstring>
 #include "board.h"
+#include "bitboard.h"
+#include "search.h"
 
 /*
  * Make a standard 8x8 othello board and initialize it to the standard setup.
@@ -13,33 +17,45 @@ Board::Board(Side side) {
 
 	// Store a basic method of assigning scores to different squares
 	simpleScores = vector<int>(64, 1);
-
-	// Corners have the highest score, edges also have high score,
-	// Boxes next to edges and corners have lower scores.
-	for (unsigned int i = 0; i < simpleScores.size(); i++) {
-		if (i % 8 == 0 || i % 8 == 7) simpleScores[i] *= 3;
-		if (i < 8 || i > 55) simpleScores[i] *= 3;
-		if ((i/8 == 2 || i/8 == 5) && !(i == 16 || i == 23 || i == 40 || i == 47)) simpleScores[i] = -2*abs(simpleScores[i]);
-		if ((i%8 == 2 || i%8 == 5) && !(i == 2 || i == 58 || i == 61 || i == 5)) simpleScores[i] = -2*abs(simpleScores[i]);
-		if (i/8 == 1 || i/8 == 6) simpleScores[i] = -5*abs(simpleScores[i]);
-		if (i % 8 == 1 || i % 8 == 6) simpleScores[i] = -5*abs(simpleScores[i]);
-	}
-
-	simpleScores[9] *= 3;
-	simpleScores[14] *= 3;
-	simpleScores[49] *= 3;
-	simpleScores[54] *= 3;
+	squareWeights(simpleScores.data());
 	numOpen = 0;
 		
 	myFrontierSquares = 0;
 	theirFrontierSquares = 0;
 	
-	// Create the transposition table
-	for (int i = 0; i < 64; i++) {
-		hashTable[i] = new linkedList();
-	}
+	// Create the transposition table. Each of the 64 lists holds at most
+	// a dozen nodes, so the whole pool is allocated here at startup.
+	nodePool = new NodePool(64 * 12);
 
 	moveToDo = new Move(-1, -1);
+	nodes = 0;
+	// No persistent cache unless one is given
+	cache = NULL;
+	// Nor an evaluation cache
+	evalCache = NULL;
+	evalProbes = 0;
+	evalHits = 0;
+	// The hand picked evaluation weights, unless tuned ones are given
+	weights = standardWeights();
+	// And no network unless one is given
+	network = NULL;
+	accumulator = NULL;
+	// No principal variation yet
+	ply = 0;
+	pvLength[0] = 0;
+	prevPvLength = 0;
+	followPv = false;
+	pvRootBlack = pvRootTaken = 0;
+	// And no limits on the search besides the old time check
+	stop = false;
+	multiPv = 1;
+	numRootLines = 0;
+	numPrevRootLines = 0;
+	nodeLimit = 0;
+	hasDeadline = false;
+	progress = NULL;
+	progressContext = NULL;
+	progressInterval = 1000;
 	
 	// Use bitboards instead of the more memory intensive bitset
 	blackb = 0b000000000000000000000000000100000010000000000000000000000000000;
@@ -51,6 +67,9 @@ Board::Board(Side side) {
  * Destructor for the board.
  */
 Board::~Board() {
+	delete nodePool;
+	delete moveToDo;
+	delete accumulator;
 }
 
 /*
@@ -104,6 +123,22 @@ int Board::hasMoves(Side side) {
     return -1;
 }
 
+/*
+ * Fills list with the indices x + y*8 of all legal moves for the given side,
+ * in the same order the searches have always tried them, and returns how
+ * many there are. list must have room for 64 entries.
+ */
+int Board::getMoves(Side side, int *list) {
+	int n = 0;
+	for (int i = 0; i < 8; i++) {
+		for (int j = 0; j < 8; j++) {
+			Move move(i, j);
+			if (checkMove(&move, side)) list[n++] = i + j*8;
+		}
+	}
+	return n;
+}
+
 /*
  * Returns the best move if there are legal moves for the given side.
  */
@@ -158,322 +193,271 @@ bool Board::checkMove(Move *m, Side side) {
 }
 
 /*
- * Does the minimax to find the best move to make and its score.
- * Returns the score of the board after making the move, and changes
- * the state of the best move for the board.
- * Uses DFS
+ * Does the minimax to find the best move to make and its score, using the
+ * count of discs alone if testing. Returns the score of the board after
+ * making the move, and changes the state of the best move for the board.
  */
-
 int Board::getBest(int depth, int player, bool testing, bool topLevel) {
-	// Figures out which color the current move is for
-	Side side;
-	if (player == 1)
-		side = mySelf;
-	else side = opp;
-	// If there are no valid moves for this player or we have reached
-	// maximum depth, reutrn the score of the board right now
-	if((hasMoves(side) == -1) || depth <= 0) {
-		if (testing) return basicHeuristic() * player;
-		else return betterHeuristic() * player;
-	}
-	// Find the best move and score
-	bool changed = false;
-	int bestScore = -1000000000;
-	for (int i = 0; i < 8; i++) {
-		for (int j = 0; j < 8;j++) {
-			Move *possMove = new Move(i, j);
-			// Check if a move is valid and if it is, do the move, and 
-			// find the score of doing minimax on that
-			// board for the opposite player
-			if (checkMove(possMove, side)) {
-				doMove(possMove, side);
-				int score = -1*getBest(depth - 1, -player, testing, false);
-				// If this move yields a higher score than so far, do
-				// it and if we are in the top level of recursion, change
-				// the move we must to do to this move
-				if (score > bestScore) {
-					bestScore = score;
-					if (topLevel) {
-						moveToDo->setX(possMove->getX());
-						moveToDo->setY(possMove->getY());
-					}
-					changed = true;
-				}
-				// Delete memory allocated for variables we don't need
-				// anymore and undo the move we have done
-				undoMove();
-			}
-			if (possMove != NULL) delete possMove;
-		}
-	}
-	// If we couldn't find any best move, just set the move we need to
-	// do to -1, which is a flag to the player that there are no moves left
-	if (!changed) {
-		moveToDo->setX(-1);
-	}
-	return bestScore;
-} 
+	if (testing)
+		return search<DiscMinimaxSearch>(depth, -1000000000, 1000000000, player, topLevel, true, 0);
+	return search<MinimaxSearch>(depth, -1000000000, 1000000000, player, topLevel, true, 0);
+}
 
 /*
  * Does the minimax to find the best move to make and its score using alpha
  * beta pruning to avoid looking at branches that neither the opponent nor
  * you will want to pick
  */
-
 int Board::alphabeta(int depth, int alpha, int beta, int player, bool topLevel, double timeTaken) {
-	// If the recursive calls are taking too much time, exit
-	if (timeTaken > 240) {
-		moveToDo->setX(-3);
-		return 65;
-	}
-	// Find the start time
-	time_t startTime, endTime;
-	time(&startTime);
-	// Figures out which color the current move is for
-	Side side;
-	if (player == 1)
-		side = mySelf;
-	else side = opp;
-	// If there are no valid moves for this player or we have reached
-	// maximum depth, return the score of the board right now
-	if((hasMoves(side) == -1) || depth <= 0) {
-		return betterHeuristic()*player;
-	}
-	// Find the hash value of the current state of the board and check
-	// if it is already in the hash table
-	int hashVal = hashFind();
-	std::string rep = boardRepresentation();
-	int val = hashTable[hashVal]->find(rep);
-	if (val != -1) {
-		// Find the alpha value and the move done
-		//int alph = val/100;
-		int moveDid = abs(val)%100;
-		// If a move was done in this case, and it wasn't just alpha stored
-		// do that move and check it at the correct depth now
-		if (moveDid < 64) {
-			doMove(moveToDo, side);
-			time (&endTime);
-			int score = -1*alphabeta(depth - 1, -beta, -alpha, -player, false, difftime(endTime, startTime) + timeTaken);
-			// Check if it took too much time
-			if (abs(score) == 65 && moveToDo->x == -3) {
-				undoMove();
-				return 65;
-			}
-			// If this score is bigger than current alpha then make it
-			// the alpha
-			if (score > alpha) {
-				alpha = score;
-				moveToDo->setX(moveDid%8);
-				moveToDo->setY(moveDid/8);
-			}
-			undoMove();
-		}
-	}
+	return search<AlphaBetaSearch>(depth, alpha, beta, player, topLevel, true, timeTaken);
+}
 
-	// Find the best move and score
-	bool leave = false;
-	
-	if (topLevel && moveToDo->x != -1 && moveToDo->y != -1) {
-		doMove(moveToDo, side);
-		time (&endTime);
-		int score = -1*alphabeta(depth - 1, -beta, -alpha, -player, false, difftime(endTime, startTime) + timeTaken);
-		if (abs(score) == 65 && moveToDo->x == -3) {
-			undoMove();
-			return 65;
-		}
-		// If this move yields a higher score than so far, do
-		// it and if we are in the top level of recursion, change
-		// the move we must to do to this move
-		if (score > alpha) {
-			alpha = score;
-		}
-		else {
-			moveToDo->setX(-1);
-			moveToDo->setY(-1);
+// An improved version of alpha beta pruning, in which if we are not 
+// looking at the first child, we can do a narrow window search first
+int Board::negascout(int depth, int alpha, int beta, int player, bool topLevel, bool firstChild, double timeTaken) {
+	return search<NegascoutSearch>(depth, alpha, beta, player, topLevel, firstChild, timeTaken);
+}
+
+/*
+ * Called at the root of each search. Keeps the line of the last search to
+ * try first, if it was searched from this position or the position two
+ * plies along it.
+ */
+void Board::startPrincipalVariation() {
+	int from = -1;
+	if (blackb == pvRootBlack && takenb == pvRootTaken) from = 0;
+	else if (pvLength[0] > 2) {
+		// Replay our move and the reply we expected
+		uint64_t me = (mySelf == BLACK) ? pvRootBlack : pvRootTaken & ~pvRootBlack;
+		uint64_t other = pvRootTaken & ~me;
+		for (int i = 0; i < 2; i++) {
+			uint64_t flips = flipMask(pv[0][i], me, other);
+			me |= flips | (one << pv[0][i]);
+			other &= ~flips;
+			uint64_t t = me;
+			me = other;
+			other = t;
 		}
-		undoMove();
-	}
+		uint64_t black = (mySelf == BLACK) ? me : other;
+		if (black == blackb && (me | other) == takenb) from = 2;
+	}
+	prevPvLength = 0;
+	if (from >= 0) {
+		for (int i = from; i < pvLength[0]; i++) prevPv[prevPvLength++] = pv[0][i];
+	}
+	// The other lines of a multi-PV search only help from the same root
+	numPrevRootLines = (from == 0 && multiPv > 1) ? numRootLines : 0;
+	for (int i = 0; i < numPrevRootLines; i++) {
+		prevRootLength[i] = rootLength[i];
+		for (int j = 0; j < rootLength[i]; j++) prevRootLine[i][j] = rootLine[i][j];
+	}
+	followPv = prevPvLength > 0;
+	pvRootBlack = blackb;
+	pvRootTaken = takenb;
+	pvLength[0] = 0;
+}
 
-	for (int i = 0; i < 8; i++) {
-		for (int j = 0; j < 8;j++) {
-			Move *possMove = new Move(i, j);
-			// Check if a move is valid and if it is, do the move, and 
-			// find the score of doing minimax on that
-			// board for the opposite player
-			if (checkMove(possMove, side)) {
-				doMove(possMove, side);
-				time (&endTime);
-				int score = -1*alphabeta(depth - 1, -beta, -alpha, -player, false, difftime(endTime, startTime) + timeTaken);
-				if (abs(score) == 65 && moveToDo->x == -3) {
-					undoMove();
-					return 65;
-				}
-				// If this move yields a higher score than so far, do
-				// it and if we are in the top level of recursion, change
-				// the move we must to do to this move
-				if (score > alpha) {
-					alpha = score;
-					if (topLevel) {
-						moveToDo->setX(possMove->getX());
-						moveToDo->setY(possMove->getY());
-					}
-				}
-				// If the score is greater than beta, we know our opponent
-				// never would have let us do well, or we would have never
-				// let our opponent do so well, so we can cut off the branch
-				if (score >= beta) leave = true;
-				undoMove();
-				// Delete memory allocated for variables we don't need
-				// anymore and undo the move we have done
-			}
-			if (possMove != NULL) delete possMove;
-			if (leave) {
-				addToHashTable(hashVal, rep, 66, alpha);
-				return alpha;
-			}
+/*
+ * Puts a root move and the line found below it among the best lines of a
+ * multi-PV search, in order of score, dropping the worst if there are too
+ * many.
+ */
+void Board::addRootLine(int move, int score) {
+	int i = (numRootLines < multiPv) ? numRootLines++ : multiPv - 1;
+	for (; i > 0 && rootScore[i - 1] < score; i--) {
+		rootScore[i] = rootScore[i - 1];
+		rootLength[i] = rootLength[i - 1];
+		for (int j = 0; j < rootLength[i]; j++) rootLine[i][j] = rootLine[i - 1][j];
+	}
+	rootScore[i] = score;
+	rootLine[i][0] = move;
+	rootLength[i] = 1;
+	for (int j = 1; j < pvLength[1]; j++) rootLine[i][rootLength[i]++] = pv[1][j];
+}
+
+/*
+ * Has the search below a multi-PV root move follow that move's line from
+ * the last search, if it had one.
+ */
+bool Board::followRootLine(int move) {
+	for (int i = 0; i < numPrevRootLines; i++) {
+		if (prevRootLine[i][0] != move) continue;
+		for (int j = 0; j < prevRootLength[i]; j++) prevPv[j] = prevRootLine[i][j];
+		prevPvLength = prevRootLength[i];
+		return true;
+	}
+	return false;
+}
+
+/*
+ * Copies line i of the last multi-PV search, best first, into line and
+ * its score into score, returning its length (0 if there is no such line).
+ */
+int Board::rootLineOf(int i, int *line, int *score) {
+	if (i >= numRootLines) return 0;
+	for (int j = 0; j < rootLength[i]; j++) line[j] = rootLine[i][j];
+	*score = rootScore[i];
+	return rootLength[i];
+}
+
+/*
+ * Makes move, followed by the best line found below it, the best line
+ * from ply here.
+ */
+void Board::updatePrincipalVariation(int here, int move) {
+	pv[here][here] = move;
+	pvLength[here] = here + 1;
+	if (here + 1 >= MAX_PLY) return;
+	for (int i = here + 1; i < pvLength[here + 1]; i++) pv[here][i] = pv[here + 1][i];
+	if (pvLength[here + 1] > here + 1) pvLength[here] = pvLength[here + 1];
+}
+
+/*
+ * Checks the limits on the running search, and reports progress when it is
+ * due. The clock is only read every 1024 nodes.
+ */
+bool Board::searchAborted() {
+	if (stop.load(std::memory_order_relaxed)) return true;
+	if (nodeLimit > 0 && nodes >= nodeLimit) stop = true;
+	else if ((nodes & 1023) == 0 && (hasDeadline || progress != NULL)) {
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		if (hasDeadline && now >= deadline) stop = true;
+		if (progress != NULL && now >= nextProgress) {
+			nextProgress = now + std::chrono::milliseconds(progressInterval);
+			progress(progressContext);
 		}
 	}
-	if (topLevel)
-		addToHashTable(hashVal, rep, moveToDo->x + moveToDo->y*8, alpha);
-	else
-		addToHashTable(hashVal, rep, 66, alpha);
-	return alpha;
-} 
+	return stop.load(std::memory_order_relaxed);
+}
 
-// An improved version of alpha beta pruning, in which if we are not 
-// looking at the first child, we can do a narrow window search first
-int Board::negascout(int depth, int alpha, int beta, int player, bool topLevel, bool firstChild, double timeTaken) {
-	// If we have taken too much time, then leave
-	if (timeTaken > 240) {
-		moveToDo->setX(-3);
-		return 65;
-	}
-	time_t startTime, endTime;
-	time(&startTime);
-	// Figures out which color the current move is for
-	Side side;
-	if (player == 1)
-		side = mySelf;
-	else side = opp;
-	// If there are no valid moves for this player or we have reached
-	// maximum depth, return the score of the board right now
-	if((hasMoves(side) == -1) || depth <= 0) {
-		return betterHeuristic()*player;
-	}
-	// Gets the hash value for the current board and then sees if it is already
-	// in the hash table. If so, then do the move it entails.
-	int hashVal = hashFind();
-	std::string rep = boardRepresentation();
-	int val = hashTable[hashVal]->find(rep);
-	if (val != -1) {
-		//int alph = val/100;
-		int moveDid = abs(val)%100;
-		if (moveDid < 64) {
-			doMove(moveToDo, side);
-			time (&endTime);
-			int score = -1*negascout(depth - 1, -beta, -alpha, -player, false, true, difftime(endTime, startTime) + timeTaken);
-			if (abs(score) == 65 && moveToDo->x == -3) {
-				undoMove();
-				return 65;
-			}
-			if (score > alpha) {
-				alpha = score;
-				moveToDo->setX(moveDid%8);
-				moveToDo->setY(moveDid/8);
-			}
-			undoMove();
-		}
+/*
+ * Copies the best line of the last search into line, returning its length.
+ */
+int Board::principalVariation(int *line) {
+	for (int i = 0; i < pvLength[0]; i++) line[i] = pv[0][i];
+	return pvLength[0];
+}
+
+/*
+ * Writes the best line of the last search, as squares like "d3", to
+ * standard error.
+ */
+void Board::printPrincipalVariation(int depth, int score) {
+	fprintf(stderr, "depth %d score %d pv", depth, score);
+	for (int i = 0; i < pvLength[0]; i++)
+		fprintf(stderr, " %c%d", 'a' + pv[0][i]%8, pv[0][i]/8 + 1);
+	fprintf(stderr, "\n");
+}
+
+/*
+ * Sorts a move list so the squares worth most come first, keeping the
+ * board order between squares worth the same.
+ */
+void Board::orderMoves(int *list, int numMoves) {
+	for (int i = 1; i < numMoves; i++) {
+		int move = list[i];
+		int j = i;
+		for (; j > 0 && simpleScores[list[j - 1]] < simpleScores[move]; j--)
+			list[j] = list[j - 1];
+		list[j] = move;
 	}
+}
 
-	// Find the best move and score
-	bool leave = false;
-	bool first = true;
-	
-	// If it is the top level and we have a moveToDo from a previous
-	// iteration, try that out first
-	if (topLevel && moveToDo->x != -1 && moveToDo->y != -1) {
-		doMove(moveToDo, side);
-		time (&endTime);
-		int score = -1*alphabeta(depth - 1, -beta, -alpha, -player, false, difftime(endTime, startTime) + timeTaken);
-		if (abs(score) == 65 && moveToDo->x == -3) {
-			undoMove();
-			return 65;
-		}
-		// If this move yields a higher score than so far, do
-		// it and if we are in the top level of recursion, change
-		// the move we must to do to this move
-		if (score > alpha) {
-			alpha = score;
-		}
-		else {
-			moveToDo->setX(-1);
-			moveToDo->setY(-1);
+/*
+ * Sorts a move list by the scores of the positions the moves lead to,
+ * which are for us, best first for player (1 for us, -1 for the
+ * opponent). The scores are sorted along with the moves.
+ */
+void Board::orderMoves(int *list, int numMoves, int *scores, int player) {
+	for (int i = 1; i < numMoves; i++) {
+		int move = list[i], score = scores[i];
+		int j = i;
+		for (; j > 0 && scores[j - 1]*player < score*player; j--) {
+			list[j] = list[j - 1];
+			scores[j] = scores[j - 1];
 		}
-		undoMove();
+		list[j] = move;
+		scores[j] = score;
 	}
+}
 
-	for (int i = 0; i < 8; i++) {
-		for (int j = 0; j < 8;j++) {
-			Move *possMove = new Move(i, j);
-			// Check if a move is valid and if it is, do the move, and 
-			// find the score of doing negascout on that
-			// board for the opposite player
-			if (checkMove(possMove, side)) {
-				doMove(possMove, side);
-				time (&endTime);
-				int score;
-				// If it is not the first child, can do a narrow window search
-				// and adjust search acocrdingly
-				if (!first) {
-					score = -1*negascout(depth - 1, -alpha - 1, -alpha, -player, false, first, difftime(endTime, startTime) + timeTaken);
-					if (score < beta && score > alpha)
-						score = -1*negascout(depth - 1, -beta, -score, -player, false, first, difftime(endTime, startTime) + timeTaken);
-				}
-				// If it is the first child, do negascout as you would for
-				// any other thing.
-				else
-					score = -1*negascout(depth - 1, -beta, -alpha, -player, false, first, difftime(endTime, startTime) + timeTaken);
-				first = false;
-				if (abs(score) == 65 && moveToDo->x == -3) {
-					undoMove();
-					return 65;
-				}
-				// If this move yields a higher score than so far, do
-				// it and if we are in the top level of recursion, change
-				// the move we must to do to this move
-				if (score > alpha) {
-					alpha = score;
-					if (topLevel) {
-						moveToDo->setX(possMove->getX());
-						moveToDo->setY(possMove->getY());
-					}
-				}
-				if (alpha >= beta) leave = true;
-				undoMove();
-				// Delete memory allocated for variables we don't need
-				// anymore and undo the move we have done
-			}
-			if (possMove != NULL) delete possMove;
-			if (leave) {
-			//	addToHashTable(hashVal, rep, 66, alpha);
-				return alpha;
+/*
+ * Scores the position after each move in list the way betterHeuristic
+ * would for the window low to high, all in one batch.
+ */
+void Board::scoreMoves(Side side, const int *list, int numMoves, int low, int high, int *scores) {
+	uint64_t black = blackb, white = takenb & ~blackb;
+	uint64_t mover = (side == BLACK) ? black : white;
+	uint64_t other = (side == BLACK) ? white : black;
+	uint64_t mine[64], theirs[64];
+	// The children the evaluation cache does not know, by their place in list
+	int missed[64], numMissed = 0;
+	for (int k = 0; k < numMoves; k++) {
+		uint64_t flips = flipMask(list[k], mover, other);
+		uint64_t after = mover | flips | (one << list[k]);
+		// betterHeuristic always scores for us
+		uint64_t us = (side == mySelf) ? after : other & ~flips;
+		uint64_t them = (side == mySelf) ? other & ~flips : after;
+		if (evalCache != NULL) {
+			evalProbes++;
+			if (evalCache->probe(us, them, &scores[k])) {
+				evalHits++;
+				continue;
 			}
 		}
+		mine[numMissed] = us;
+		theirs[numMissed] = them;
+		missed[numMissed++] = k;
+	}
+	if (numMissed == 0) return;
+	int found[64];
+	evaluateBatch(weights, mine, theirs, numMissed, low, high, found);
+	for (int i = 0; i < numMissed; i++) {
+		scores[missed[i]] = found[i];
+		// Inside the window the lazy evaluation is exact
+		if (evalCache != NULL && low < found[i] && found[i] < high) evalCache->store(mine[i], theirs[i], found[i]);
 	}
-	//if (topLevel)
-	//	addToHashTable(hashVal, rep, moveToDo->x + moveToDo->y*8, alpha);
-	//else
-	//	addToHashTable(hashVal, rep, 66, alpha);
-	return alpha;
-} 
+}
+
+/*
+ * Hands a finished search result to the persistent cache. A search deep
+ * enough for every line to reach the end of the game is saved as solved, so
+ * it satisfies any later search of the position with this evaluation.
+ */
+void Board::cacheResult(uint64_t key, int depth, int bound, int score, int move) {
+	if (depth >= 64 - __builtin_popcountll(takenb)) depth = CACHE_SOLVED_DEPTH;
+	cache->record(key, score, depth, bound, move);
+}
+
+/*
+ * Zobrist key of the board with the given side to move
+ */
+uint64_t Board::zobristKey(Side toMove) {
+	return zobristHash(blackb, takenb & ~blackb, toMove);
+}
+
+/*
+ * Zobrist key of the board under whichever symmetry gives the smallest,
+ * which is left in symmetry
+ */
+uint64_t Board::canonicalKey(Side toMove, int *symmetry) {
+	return canonicalZobristHash(blackb, takenb & ~blackb, toMove, symmetry);
+}
+
+/*
+ * Looks up the hash table, returning -1 if the position is not there
+ */
+int Board::findInHashTable(int hashVal, uint64_t black, uint64_t taken) {
+	return hashTable[hashVal].find(black, taken);
+}
 
 /*
  * Adds to the hash table
  */
-void Board::addToHashTable(int hashVal, std::string rep, int move, int alpha) {
+void Board::addToHashTable(int hashVal, uint64_t black, uint64_t taken, int move, int alpha) {
 	if (alpha < 0) 
-		hashTable[hashVal]->add(rep, -(move + 100*abs(alpha)));
-	else hashTable[hashVal]->add(rep, move + 100*alpha);
+		hashTable[hashVal].add(black, taken, -(move + 100*abs(alpha)), nodePool);
+	else hashTable[hashVal].add(black, taken, move + 100*alpha, nodePool);
 }
 
 /*
@@ -490,8 +474,8 @@ void Board::doMove(Move *m, Side side) {
     int Y = m->getY();
     // Add the move -1 as a marker between moves and then push the current
     // move that we want to do
-    Board::moves->push(-1);
-    Board::moves->push(X + Y*8);
+    moves.push(-1);
+    moves.push(X + Y*8);
     Side other = (side == BLACK) ? WHITE : BLACK;
     for (int dx = -1; dx <= 1; dx++) {
         for (int dy = -1; dy <= 1; dy++) {
@@ -513,10 +497,15 @@ void Board::doMove(Move *m, Side side) {
 					// Add the stones we are turning as part of the move
 					// to our stack of moves done					
 					if (takenb & (one << (x+8*y))) {
-						if (blackb & (one << (x+8*y))) Board::moves->push(x+y*8 + 100);
-						else Board::moves->push(x+y*8 + 200);
+						if (blackb & (one << (x+8*y))) moves.push(x+y*8 + 100);
+						else moves.push(x+y*8 + 200);
+					}
+					else moves.push(x+y*8);
+					// Keep the network's accumulator in step with the stones
+					if (network != NULL) {
+						network->remove(accumulator, x+y*8, other);
+						network->add(accumulator, x+y*8, side);
 					}
-					else Board::moves->push(x+y*8);
 					
                     set(side, x, y);
                     x += dx;
@@ -530,8 +519,9 @@ void Board::doMove(Move *m, Side side) {
     if ((X == 0 && (Y == 0 || Y == 7)) || (X == 7 && (Y == 0 || Y == 7)))
 		setCornerScore(X*8 + Y, side);
     set(side, X, Y);
+    if (network != NULL) network->add(accumulator, X + Y*8, side);
 	// As a marker between moves, push a move -1
-	Board::moves->push(-1);
+	moves.push(-1);
 }
 
 /*
@@ -540,12 +530,12 @@ void Board::doMove(Move *m, Side side) {
  */
 void Board::undoMove() {
 	// If there are -1 markers at the top of our stack, pop them off
-	while (!Board::moves->empty() && moves->top() == -1) {
-		Board::moves->pop();
+	while (!moves.empty() && moves.top() == -1) {
+		moves.pop();
 	}
 	// Make sure we don't go past capacity of stack
-	while (!Board::moves->empty()) {
-		int top = Board::moves->top();
+	while (!moves.empty()) {
+		int top = moves.top();
 		// If our top value is -1, that means we have reached a marker
 		// between moves we are trying out, and we are done undoing this move
 		if (top == -1) {
@@ -557,6 +547,7 @@ void Board::undoMove() {
 		// The moves are encoded as move = x + y*8 + 100*side, where side is
 		// 0 if the square was empty before, 1 if it was black before, 
 		// and 2 if it was white before
+		if (network != NULL) undoAccumulator(top);
 		if (top < 100) {
 			takenb &= ~(one << top);
 			blackb &= ~(one << top);
@@ -569,10 +560,44 @@ void Board::undoMove() {
 			takenb |= (one << top%200);
 			blackb &= ~(one << top%200);
 		}
-		Board::moves->pop();
+		moves.pop();
 	}
 }
 
+/*
+ * Takes back one entry of the move stack from the network's accumulator,
+ * before the board itself is changed back.
+ */
+void Board::undoAccumulator(int top) {
+	int square = top % 100;
+	Side now = ((blackb >> square) & 1) ? BLACK : WHITE;
+	// The stone placed by the move goes, a turned stone turns back
+	network->remove(accumulator, square, now);
+	if (top >= 100) network->add(accumulator, square, (now == BLACK) ? WHITE : BLACK);
+}
+
+/*
+ * Scores positions with the given network instead of the weighted
+ * features, or with the features again if network is NULL.
+ */
+void Board::setNetwork(const Network *net) {
+	network = net;
+	if (network == NULL) return;
+	if (accumulator == NULL) accumulator = new Accumulator();
+	network->refresh(accumulator, getBlack(), getWhite());
+}
+
+/*
+ * Whether the accumulator kept up to date by doMove and undoMove holds what
+ * summing it afresh for the stones on the board gives. For checks only.
+ */
+bool Board::accumulatorMatches() {
+	if (network == NULL) return true;
+	Accumulator fresh;
+	network->refresh(&fresh, getBlack(), getWhite());
+	return memcmp(fresh.v, accumulator->v, sizeof(fresh.v)) == 0;
+}
+
 /*
  * Current count of given side's stones.
  */
@@ -606,6 +631,20 @@ int Board::countWhite() {
 	return countTaken - countBlack();
 }
 
+/*
+ * Bitboard of the black stones.
+ */
+uint64_t Board::getBlack() {
+	return blackb;
+}
+
+/*
+ * Bitboard of the white stones.
+ */
+uint64_t Board::getWhite() {
+	return takenb & ~blackb;
+}
+
 /* 
  * Calculates the score using a basic heuristic, number of our stones
  * minus the number of the opponent's stones.
@@ -616,85 +655,51 @@ int Board::basicHeuristic() {
 }
 
 /*
- * Calculates the score using a better heuristic - Is not working correctly
+ * Calculates the score using a better heuristic: a weighted sum of stones,
+ * corners, edges, mobility and frontier squares, using the weights for the
+ * current phase of the game.
  */
 int Board::betterHeuristic() {
-	int stoneDiff = basicHeuristic();
-	int yourStable = 0;
-	int theirStable = 0;
-	if (get(mySelf, 0, 0)) {
-		yourStable ++;
-		if (get(mySelf, 1, 0)) yourStable++;
-		if (get(mySelf, 1, 1)) yourStable++;
-		if (get(mySelf, 0, 1)) yourStable++;
-	}
-	else if (get(opp, 0, 0)) {
-		theirStable ++;
-		if (get(opp, 1, 0)) theirStable++;
-		if (get(opp, 1, 1)) theirStable++;
-		if (get(opp, 0, 1)) theirStable++;
-	}
-
-	if (get(mySelf, 7, 0)) {
-		yourStable ++;
-		if (get(mySelf, 6, 0)) yourStable++;
-		if (get(mySelf, 6, 1)) yourStable++;
-		if (get(mySelf, 7, 1)) yourStable++;
-	}
-	else if (get(opp, 7, 0)) {
-		theirStable ++;
-		if (get(opp, 6, 0)) theirStable++;
-		if (get(opp, 6, 1)) theirStable++;
-		if (get(opp, 7, 1)) theirStable++;
-	}
-
-	if (get(mySelf, 0, 7)) {
-		yourStable ++;
-		if (get(mySelf, 1, 7)) yourStable++;
-		if (get(mySelf, 1, 6)) yourStable++;
-		if (get(mySelf, 0, 6)) yourStable++;
-	}
-	else if (get(opp, 0, 7)) {
-		theirStable ++;
-		if (get(opp, 1, 7)) theirStable++;
-		if (get(opp, 1, 6)) theirStable++;
-		if (get(opp, 0, 6)) theirStable++;
-	}
-
-	if (get(mySelf, 7, 7)) {
-		yourStable ++;
-		if (get(mySelf, 6, 7)) yourStable++;
-		if (get(mySelf, 6, 6)) yourStable++;
-		if (get(mySelf, 7, 6)) yourStable++;
-	}
-	else if (get(opp, 7, 7)) {
-		theirStable ++;
-		if (get(opp, 6, 7)) theirStable++;
-		if (get(opp, 6, 6)) theirStable++;
-		if (get(opp, 7, 6)) theirStable++;
+	if (network != NULL) return network->evaluate(accumulator, mySelf);
+	uint64_t black = blackb, white = takenb & ~blackb;
+	uint64_t me = (mySelf == BLACK) ? black : white;
+	uint64_t them = (mySelf == BLACK) ? white : black;
+	int score;
+	if (evalCache != NULL) {
+		evalProbes++;
+		if (evalCache->probe(me, them, &score)) {
+			evalHits++;
+			return score;
+		}
 	}
+	score = evaluate(weights, me, them);
+	if (evalCache != NULL) evalCache->store(me, them, score);
+	return score;
+}
 
-	int myEdges = 0, theirEdges = 0;
-	
-	for (int i = 2; i < 5; i++) {
-		if (get(mySelf, i, 0)) myEdges++;
-		else if(get(opp, i, 0)) theirEdges++;
-		if (get(mySelf, 0, i)) myEdges++;
-		else if(get(opp, 0, i)) theirEdges++;
-		if (get(mySelf, i, 7)) myEdges++;
-		else if(get(opp, i, 7)) theirEdges++;
-		if (get(mySelf, 7, i)) myEdges++;
-		else if(get(opp, 7, i)) theirEdges++;
-	}
-	
-	int myMoves = getMyNumMoves();
-	int theirMoves = getOppNumMoves();
-	if (numOpen < 5) {
-		return stoneDiff*40 + (yourStable - theirStable) * 20;
+/*
+ * The same score, unless the cheap terms alone show it is at most alpha or
+ * at least beta, in which case that bound is given instead. The window is
+ * from our side, as the score is. A score found in the evaluation cache is
+ * always exact.
+ */
+int Board::betterHeuristic(int alpha, int beta) {
+	if (network != NULL) return network->evaluate(accumulator, mySelf);
+	uint64_t black = blackb, white = takenb & ~blackb;
+	uint64_t me = (mySelf == BLACK) ? black : white;
+	uint64_t them = (mySelf == BLACK) ? white : black;
+	int score;
+	if (evalCache != NULL) {
+		evalProbes++;
+		if (evalCache->probe(me, them, &score)) {
+			evalHits++;
+			return score;
+		}
 	}
-	return (stoneDiff + (yourStable - theirStable) * 30 + 
-	(myEdges - theirEdges)*15 + (myMoves-theirMoves)*20 + 
-	(theirFrontierSquares - myFrontierSquares)*5);
+	score = evaluateLazy(weights, me, them, alpha, beta);
+	// Only a score inside the window is sure to be exact
+	if (evalCache != NULL && alpha < score && score < beta) evalCache->store(me, them, score);
+	return score;
 }
 
 /*
@@ -716,58 +721,37 @@ void Board::setBoard(char data[]) {
 			takenb |= (one << i);
 		}
 	} 
+	if (network != NULL) network->refresh(accumulator, getBlack(), getWhite());
+}
+
+/*
+ * Sets the board to the given black and white stones.
+ */
+void Board::setPosition(uint64_t black, uint64_t white) {
+	blackb = black;
+	takenb = black | white;
+	if (network != NULL) network->refresh(accumulator, getBlack(), getWhite());
 }
 
 /*
  * Returns the number of moves my program's player has, also updating
- * the number of open and frontier squares.
+ * the number of open squares and of our stones next to one.
  */
 int Board::getMyNumMoves(){
-	int count = 0;
-	myFrontierSquares = 0;
-	numOpen = 0;
-	for (int i = 0; i < 7; i++) {
-		for (int j = 0; j < 7; j++) {
-			if (!(takenb & (one << (i+j*8)))) numOpen++;
-			Move move(i, j);
-			if (checkMove(&move, mySelf)) count++;
-			if (get(mySelf, i, j)) {
-				for(int dx = -1; dx <=1; dx++) {
-					for (int dy = -1; dy <=1; dy++) {
-						if (onBoard(i+dx, j+dy) && !(takenb & one << ((i+dx)+(j+dy)*8))) {
-							myFrontierSquares ++;
-						}
-					}
-				}
-			}
-		}
-	}
-	return count;
+	uint64_t mine = (mySelf == BLACK) ? getBlack() : getWhite();
+	numOpen = __builtin_popcountll(~takenb);
+	myFrontierSquares = __builtin_popcountll(mine & neighbours(~takenb));
+	return __builtin_popcountll(moveMask(mine, takenb & ~mine));
 }
 
 /*
  * Returns the number of moves my opponent's player has, also updating
- * the number of frontier squares.
+ * the number of their stones next to an open square.
  */
 int Board::getOppNumMoves() {
-	int count = 0;
-	theirFrontierSquares = 0;
-	for (int i = 0; i < 7; i++) {
-		for (int j = 0; j < 7; j++) {
-			Move move(i, j);
-			if (checkMove(&move, opp)) count++;
-			if (get(opp, i, j)) {
-				for(int dx = -1; dx <=1; dx++) {
-					for (int dy = -1; dy <=1; dy++) {
-						if (onBoard(i+dx, j+dy) && !(takenb & one << ((i+dx)+(j+dy)*8))) {
-							theirFrontierSquares ++;
-						}
-					}
-				}
-			}
-		}
-	}
-	return count;
+	uint64_t theirs = (opp == BLACK) ? getBlack() : getWhite();
+	theirFrontierSquares = __builtin_popcountll(theirs & neighbours(~takenb));
+	return __builtin_popcountll(moveMask(theirs, takenb & ~theirs));
 }
 
 /* Once we get a corner square, then the squares next to it become stable
@@ -3,14 +3,23 @@
 
 #include <bitset>
 #include "common.h"
+#include "cache.h"
+#include "zobrist.h"
+#include "eval.h"
+#include "evalcache.h"
+#include "nnue.h"
 #include <vector>
 #include <iostream>
 #include <stdlib.h>
-#include <stack>
 #include <time.h>
 using namespace std;
 #include <map>
 #include <cstdint>
+#include <atomic>
+#include <chrono>
+
+// Longest line the principal variation table can hold
+#define MAX_PLY 64
 
 class Board {
    
@@ -24,19 +33,50 @@ private:
     std::vector<int> simpleScores;
 	//std::map<uint64_t, int> hashTable;
 	
-	linkedList *hashTable[64];
+	linkedList hashTable[64];
+	NodePool *nodePool;
 	
     bool occupied(int x, int y);
     bool get(Side side, int x, int y);
     void set(Side side, int x, int y);
     bool onBoard(int x, int y);\
     int myFrontierSquares;
+    Accumulator *accumulator;
+    void undoAccumulator(int top);
+    // Triangular principal variation table: row p holds the best line found
+    // from ply p, in columns p to pvLength[p] - 1
+    int ply;
+    int pv[MAX_PLY][MAX_PLY];
+    int pvLength[MAX_PLY];
+    // The line of the last search, tried first by the next one
+    int prevPv[MAX_PLY];
+    int prevPvLength;
+    bool followPv;
+    uint64_t pvRootBlack, pvRootTaken;
+    void startPrincipalVariation();
+    void updatePrincipalVariation(int here, int move);
+    // The best lines of a multi-PV root, best first, and those of the last
+    // search from the same root
+    int numRootLines;
+    int rootScore[64];
+    int rootLength[64];
+    int rootLine[64][MAX_PLY];
+    int numPrevRootLines;
+    int prevRootLength[64];
+    int prevRootLine[64][MAX_PLY];
+    void addRootLine(int move, int score);
+    bool followRootLine(int move);
     int theirFrontierSquares;
 
 public:
    	int numOpen;
+   	// Number of positions the searches have visited
+   	long nodes;
+   	// Evaluations looked up in the evaluation cache, and found there
+   	long evalProbes;
+   	long evalHits;
 
-	static std::stack<int> *moves;
+	MoveStack moves;
     Board(Side side);
     ~Board();
     Board *copy();
@@ -44,9 +84,28 @@ public:
     Side mySelf;
     Side opp;
     Move *moveToDo;
+    SolveCache *cache;
+    EvalCache *evalCache;
+    const EvalWeights *weights;
+    const Network *network;
+    SearchParams params;
+    // How many of the best root moves the search finds lines for
+    int multiPv;
+    // Limits on the running search: a stop request, possibly from another
+    // thread, a node count and a deadline. A node limit of 0 means none.
+    std::atomic<bool> stop;
+    long nodeLimit;
+    bool hasDeadline;
+    std::chrono::steady_clock::time_point deadline;
+    // Called about every progressInterval ms while searching, if set
+    void (*progress)(void *context);
+    void *progressContext;
+    long progressInterval;
+    std::chrono::steady_clock::time_point nextProgress;
 	   
     bool isDone();
     int hasMoves(Side side);
+    int getMoves(Side side, int *list);
     int bestMove(Side side);
     bool checkMove(Move *m, Side side);
     void doMove(Move *m, Side side);
@@ -54,18 +113,38 @@ public:
     int count(Side side);
     int countBlack();
     int countWhite();
+    uint64_t getBlack();
+    uint64_t getWhite();
 	int basicHeuristic();
 	int betterHeuristic();
+	int betterHeuristic(int alpha, int beta);
+	// The search, put together from the parts of Policy in search.h
+	template <class Policy>
+	int search(int depth, int alpha, int beta, int player, bool topLevel, bool firstChild, double timeTaken);
 	int getBest(int depth, int player, bool testing, bool topLevel);
 	int alphabeta(int depth, int alpha, int beta, int player, bool topLevel, double timeTaken);
     int negascout(int depth, int alpha, int beta, int player, bool topLevel, bool firstChild, double timeTaken);
+    void orderMoves(int *list, int numMoves);
+    void orderMoves(int *list, int numMoves, int *scores, int player);
+    void scoreMoves(Side side, const int *list, int numMoves, int low, int high, int *scores);
     void setBoard(char data[]);
+    void setPosition(uint64_t black, uint64_t white);
+    int principalVariation(int *line);
+    int rootLineOf(int i, int *line, int *score);
+    bool searchAborted();
+    void printPrincipalVariation(int depth, int score);
+    void setNetwork(const Network *net);
+    bool accumulatorMatches();
     int getMyNumMoves();
     int getOppNumMoves();
     void setCornerScore(int indices, Side me);
     std::string boardRepresentation();
     int hashFind();
-    void addToHashTable(int hashVal, std::string rep, int move, int alpha);
+    uint64_t zobristKey(Side toMove);
+    uint64_t canonicalKey(Side toMove, int *symmetry);
+    void cacheResult(uint64_t key, int depth, int bound, int score, int move);
+    int findInHashTable(int hashVal, uint64_t black, uint64_t taken);
+    void addToHashTable(int hashVal, uint64_t black, uint64_t taken, int move, int alpha);
 	void printBoard();
 };
 
@@ -0,0 +1,194 @@
+#include "cache.h"
+#include <algorithm>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+/**
+ * Header at the start of the cache file, followed by count entries sorted
+ * by key.
+ */
+struct CacheHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t count;
+	// The evaluation that scored the entries
+	uint64_t evaluator;
+};
+
+static const char CACHE_MAGIC[8] = {'E', 'E', 'Y', 'C', 'A', 'C', 'H', 'E'};
+// Bumped whenever the header changes or stored scores stop meaning what
+// they did, as when the evaluation features change, so old files are
+// ignored
+#define CACHE_VERSION 3
+
+SolveCache::SolveCache(const char *file, int maxEntries, int minDepth, uint64_t evaluator) {
+	path = file;
+	entries = NULL;
+	numEntries = 0;
+	mappedSize = 0;
+	this->maxEntries = maxEntries;
+	this->minDepth = minDepth;
+	this->evaluator = evaluator;
+	// A game never produces more than this many deep results, and the buffer
+	// is made now so that recording never allocates during a search
+	pendingCapacity = 1 << 16;
+	pending = new CacheEntry[pendingCapacity];
+	numPending = 0;
+}
+
+SolveCache::~SolveCache() {
+	if (entries != NULL) munmap((void *) ((const char *) entries - sizeof(CacheHeader)), mappedSize);
+	delete[] pending;
+}
+
+/*
+ * Maps the cache file read only. A missing or malformed file, or one from
+ * another evaluation, just leaves the cache empty. Returns whether anything
+ * was loaded.
+ */
+bool SolveCache::load() {
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) return false;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(CacheHeader)) {
+		close(fd);
+		return false;
+	}
+	void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	// The mapping stays valid after the file is closed, and after another
+	// process renames a new file over it
+	close(fd);
+	if (map == MAP_FAILED) return false;
+
+	const CacheHeader *header = (const CacheHeader *) map;
+	if (memcmp(header->magic, CACHE_MAGIC, 8) != 0 || header->version != CACHE_VERSION ||
+		header->evaluator != evaluator ||
+		sizeof(CacheHeader) + header->count * sizeof(CacheEntry) > (size_t) st.st_size) {
+		munmap(map, st.st_size);
+		return false;
+	}
+	mappedSize = st.st_size;
+	entries = (const CacheEntry *) ((const char *) map + sizeof(CacheHeader));
+	numEntries = header->count;
+	return true;
+}
+
+/*
+ * Looks a key up in the mapped file with a binary search, copying the entry
+ * to out if it is there.
+ */
+bool SolveCache::probe(uint64_t key, CacheEntry *out) {
+	int lo = 0, hi = numEntries - 1;
+	while (lo <= hi) {
+		int mid = (lo + hi) / 2;
+		if (entries[mid].key == key) {
+			*out = entries[mid];
+			return true;
+		}
+		if (entries[mid].key < key) lo = mid + 1;
+		else hi = mid - 1;
+	}
+	return false;
+}
+
+/*
+ * Remembers a result found in this game so it can be saved at the end of it.
+ */
+void SolveCache::record(uint64_t key, int score, int depth, int bound, int move) {
+	if (depth < minDepth) return;
+	std::lock_guard<std::mutex> guard(pendingLock);
+	if (numPending == pendingCapacity) return;
+	CacheEntry &e = pending[numPending++];
+	e.key = key;
+	e.score = score;
+	e.depth = depth;
+	e.bound = bound;
+	e.move = move;
+	e.unused = 0;
+}
+
+/*
+ * Orders entries by key, and entries with the same key so the one worth
+ * keeping comes first: the deepest, and exact before bounds.
+ */
+static bool entryOrder(const CacheEntry &a, const CacheEntry &b) {
+	if (a.key != b.key) return a.key < b.key;
+	if (a.depth != b.depth) return a.depth > b.depth;
+	return a.bound < b.bound;
+}
+
+static bool deeperFirst(const CacheEntry &a, const CacheEntry &b) {
+	return a.depth > b.depth;
+}
+
+/*
+ * Merges this game's results into the file. Holds an exclusive lock on a
+ * lock file next to the cache while it reads the newest file (which other
+ * processes may have updated since we mapped it), merges, drops the
+ * shallowest entries beyond the size cap and renames the result into place.
+ * A file written by another evaluation is dropped rather than merged.
+ */
+bool SolveCache::saveResults() {
+	if (numPending == 0) return true;
+	std::string lockPath = path + ".lock";
+	int lockFd = open(lockPath.c_str(), O_RDWR | O_CREAT, 0644);
+	if (lockFd < 0) return false;
+	flock(lockFd, LOCK_EX);
+
+	std::vector<CacheEntry> merged(pending, pending + numPending);
+	FILE *in = fopen(path.c_str(), "rb");
+	if (in != NULL) {
+		CacheHeader header;
+		if (fread(&header, sizeof(header), 1, in) == 1 &&
+			memcmp(header.magic, CACHE_MAGIC, 8) == 0 && header.version == CACHE_VERSION &&
+			header.evaluator == evaluator) {
+			size_t old = merged.size();
+			merged.resize(old + header.count);
+			size_t got = fread(&merged[old], sizeof(CacheEntry), header.count, in);
+			merged.resize(old + got);
+		}
+		fclose(in);
+	}
+
+	std::sort(merged.begin(), merged.end(), entryOrder);
+	size_t n = 0;
+	for (size_t i = 0; i < merged.size(); i++) {
+		if (n == 0 || merged[n - 1].key != merged[i].key) merged[n++] = merged[i];
+	}
+	merged.resize(n);
+	// Depth preferred eviction: keep the deepest maxEntries results
+	if (merged.size() > (size_t) maxEntries) {
+		std::nth_element(merged.begin(), merged.begin() + maxEntries, merged.end(), deeperFirst);
+		merged.resize(maxEntries);
+		std::sort(merged.begin(), merged.end(), entryOrder);
+	}
+
+	char tmpPath[4096];
+	snprintf(tmpPath, sizeof(tmpPath), "%s.tmp.%d", path.c_str(), (int) getpid());
+	FILE *out = fopen(tmpPath, "wb");
+	bool ok = out != NULL;
+	if (ok) {
+		CacheHeader header;
+		memcpy(header.magic, CACHE_MAGIC, 8);
+		header.version = CACHE_VERSION;
+		header.count = merged.size();
+		header.evaluator = evaluator;
+		ok = fwrite(&header, sizeof(header), 1, out) == 1 &&
+			fwrite(merged.data(), sizeof(CacheEntry), merged.size(), out) == merged.size();
+		ok = (fclose(out) == 0) && ok;
+		if (ok) ok = rename(tmpPath, path.c_str()) == 0;
+		else remove(tmpPath);
+	}
+
+	flock(lockFd, LOCK_UN);
+	close(lockFd);
+	if (ok) numPending = 0;
+	return ok;
+}
@@ -0,0 +1,77 @@
+#ifndef __CACHE_H__
+#define __CACHE_H__
+
+#include <cstdint>
+#include <string>
+#include <mutex>
+
+// Kinds of score a cache entry can hold
+#define CACHE_EXACT 0
+#define CACHE_LOWER 1
+#define CACHE_UPPER 2
+
+// Depth stored for positions searched with every line reaching the end of
+// the game, which no deeper search with the same evaluation changes. Leaves
+// and positions where a side must pass are still scored by the evaluation,
+// so these are not exact disc counts.
+#define CACHE_SOLVED_DEPTH 64
+
+/**
+ * One saved search result, 16 bytes on disk.
+ */
+struct CacheEntry
+{
+	uint64_t key;
+	int32_t score;
+	uint8_t depth;
+	uint8_t bound;
+	uint8_t move;
+	uint8_t unused;
+};
+
+/**
+ * A transposition cache that outlives the process. Deep and solved results
+ * from earlier games are kept in a binary file of entries sorted by Zobrist
+ * key, which is mapped read only at startup and binary searched during the
+ * search. Results found during this game are collected in a buffer
+ * allocated up front and merged back into the file by saveResults() when the
+ * game is over. Several processes may share the same file: merges are
+ * serialised with a lock file and replace the file atomically, so a reader
+ * always maps a complete file.
+ *
+ * Search scores, solved ones included, only mean something to the
+ * evaluation that produced them, so the file is stamped with a fingerprint
+ * of it (weightsHash or Network::hash). A file stamped by another
+ * evaluation is neither used nor merged into, but replaced.
+ */
+class SolveCache {
+	std::string path;
+	// The mapped file
+	const CacheEntry *entries;
+	int numEntries;
+	size_t mappedSize;
+	// Results from this game waiting to be merged. Games searching on
+	// several threads may share the cache, so they are added under a lock.
+	CacheEntry *pending;
+	int numPending;
+	int pendingCapacity;
+	std::mutex pendingLock;
+	// Most entries the file may hold
+	int maxEntries;
+	// Fingerprint of our evaluation
+	uint64_t evaluator;
+
+public:
+	// Only results searched at least this deep are looked up or saved
+	int minDepth;
+
+	SolveCache(const char *file, int maxEntries, int minDepth, uint64_t evaluator);
+	~SolveCache();
+	bool load();
+	bool probe(uint64_t key, CacheEntry *out);
+	void record(uint64_t key, int score, int depth, int bound, int move);
+	bool saveResults();
+	int size() { return numEntries; }
+};
+
+#endif
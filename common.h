@@ -2,6 +2,7 @@
 #define __COMMON_H__
 
 #include <iostream>
+#include <cstdint>
 
 
 enum Side { 
@@ -31,14 +32,41 @@ public:
     void setY(int y) { this->y = y; }
 };
 
+/**
+ * Fixed-capacity stack of ints used to record the moves done on a board so
+ * they can be undone. Replaces std::stack so the search never has to grow a
+ * deque (and so never touches the heap).
+ */
+#define MOVE_STACK_SIZE 16384
+struct MoveStack
+{
+	int data[MOVE_STACK_SIZE];
+	int size;
+	MoveStack() {
+		size = 0;
+	}
+	void push(int v) {
+		data[size++] = v;
+	}
+	void pop() {
+		size--;
+	}
+	int top() {
+		return data[size - 1];
+	}
+	bool empty() {
+		return size == 0;
+	}
+};
+
 /**
  * Maintains a node for the linked lists in the tansposition table
  */
 struct Node
 {
-	// Stores a key value, given as a string representation of the board,
-	// with empty space for empty square, 1 for black, and 2 for white
-	std::string key;
+	// Stores a key value, given as the two bitboards of the board
+	uint64_t black;
+	uint64_t taken;
 	// Stores the alpha value for the move done in the case that this board
 	// was used
 	int value;
@@ -46,50 +74,64 @@ struct Node
 	int popularity;
 	// Stores the next node of the linked list
 	Node *next;
-	
-	Node(std::string k, int v) {
-		key = k;
+
+	void init(uint64_t b, uint64_t t, int v) {
+		black = b;
+		taken = t;
 		value = v;
 		next = NULL;
 		popularity = 0;
 	}
-	// Inserts a new node
-	void insert(std::string k, int v) {
-		// If this new node matches up to this node, just increase popularity
-		if (key.compare(k) == 0) {
-			popularity++;
-			return;
-		}
-		// If there is no next node, make this new one the next
-		if (next == NULL) {
-			next = new Node(k, v);
-		}
-		// Otherwise call insert on next node
-		else next->insert(k, v);
+	bool matches(uint64_t b, uint64_t t) {
+		return black == b && taken == t;
 	}
-	
 	// Find the value of a key
-	int find(std::string search) {
+	int find(uint64_t b, uint64_t t) {
 		// If it is this one return it
-		if (key.compare(search) == 0) {
+		if (matches(b, t)) {
 			return value;
 		}
 		// If next is null, meaning it can't be found then return -1
 		if (next == NULL) return -1;
 		// Otherwise call find on the next node
-		return next->find(search);
+		return next->find(b, t);
 	}
 	// Replace a node with a new one
-	void replace(std::string k, int val) {
+	void replace(uint64_t b, uint64_t t, int val) {
 		// Try to replace a node that has popularity 0
 		if (popularity == 0) {
-			key = k;
+			black = b;
+			taken = t;
 			value = val;
 		}
 		else if (next == NULL) {
 			return;
 		}
-		else next->replace(k, val);
+		else next->replace(b, t, val);
+	}
+};
+
+/**
+ * All the nodes of a transposition table are allocated up front in one
+ * block, so adding to the table during the search never calls new.
+ */
+struct NodePool
+{
+	Node *nodes;
+	int used;
+	int capacity;
+	NodePool(int cap) {
+		nodes = new Node[cap];
+		used = 0;
+		capacity = cap;
+	}
+	~NodePool() {
+		delete[] nodes;
+	}
+	// Hands out the next unused node, or NULL once the pool is exhausted
+	Node *alloc() {
+		if (used == capacity) return NULL;
+		return &nodes[used++];
 	}
 };
 
@@ -107,27 +149,80 @@ struct linkedList
 		size = 0;
 	}
 	// To find, call find on the first node or make a first node
-	int find(std::string search) {
+	int find(uint64_t b, uint64_t t) {
 		if (first == NULL) {
 			return -1;
 		}
-		int x = first->find(search);
-		return x;
+		return first->find(b, t);
 	}
-	// To add, call insert on the first node, or make a first node
-	// or replace if necessary
-	void add(std::string key, int val) {
-		if (first == NULL) {
-			first = new Node(key, val);
-			size++;
-		}
-		else if (size > 10) {
-			first->replace(key, val);
+	// To add, walk to the end of the list taking a node from the pool, or
+	// replace if the list is already long enough
+	void add(uint64_t b, uint64_t t, int val, NodePool *pool) {
+		if (size > 10) {
+			first->replace(b, t, val);
+			return;
 		}
-		else {
-			first->insert(key, val);
-			size++;
+		Node **slot = &first;
+		while (*slot != NULL) {
+			// If this new node matches up to a node, just increase popularity
+			if ((*slot)->matches(b, t)) {
+				(*slot)->popularity++;
+				size++;
+				return;
+			}
+			slot = &(*slot)->next;
 		}
+		Node *fresh = pool->alloc();
+		if (fresh == NULL) return;
+		fresh->init(b, t, val);
+		*slot = fresh;
+		size++;
+	}
+};
+
+/**
+ * Switches and margins for the selective parts of negascout. Margins are in
+ * evaluation units for each ply of depth left; 0 moves or depth switches a
+ * part off just as well as its flag does.
+ */
+struct SearchParams
+{
+	// Late move reductions: after the first lmrMoves moves, search the rest
+	// lmrReduction plies shallower, and again at full depth if one beats alpha
+	bool lateMoveReductions;
+	int lmrDepth;
+	int lmrMoves;
+	int lmrReduction;
+	// Futility: give up on a node whose static score is this far above beta
+	bool futility;
+	int futilityDepth;
+	int futilityMargin;
+	// Razoring: a node whose static score is this far below alpha only gets
+	// a shallower search to confirm it
+	bool razoring;
+	int razorDepth;
+	int razorMargin;
+	// Order the moves of nodes at least this deep by the static score of
+	// the position each leads to, rather than by square
+	bool evalOrdering;
+	int evalOrderDepth;
+	// Let leaves stop at the cheap evaluation terms when those already put
+	// the score outside the window
+	bool lazyEval;
+	SearchParams() {
+		lateMoveReductions = true;
+		lmrDepth = 3;
+		lmrMoves = 3;
+		lmrReduction = 1;
+		futility = true;
+		futilityDepth = 2;
+		futilityMargin = 150;
+		razoring = true;
+		razorDepth = 3;
+		razorMargin = 200;
+		evalOrdering = true;
+		evalOrderDepth = 3;
+		lazyEval = true;
 	}
 };
 
@@ -0,0 +1,392 @@
+#include <algorithm>
+#include "endgame.h"
+#include "bitboard.h"
+
+static const uint64_t CORNERS = 0x8100000000000081ULL;
+
+// Below this many empty squares, moves are tried in square order and
+// results are not stored, as in Solver
+static const int SHALLOW = 7;
+// Nodes with fewer empty squares than this are never split; the work below
+// them is too little to be worth handing to another thread
+static const int SPLIT_EMPTIES = 12;
+// How often each thread looks at the clock, in nodes searched by search();
+// each can have a thousand or so shallow nodes below it
+static const int CLOCK_CHECK = 256;
+
+static inline uint64_t hash(uint64_t me, uint64_t opp) {
+	uint64_t h = me * 0x9E3779B97F4A7C15ULL ^ opp * 0xC2B2AE3D27D4EB4FULL;
+	h ^= h >> 33;
+	h *= 0xFF51AFD7ED558CCDULL;
+	return h ^ (h >> 33);
+}
+
+/*
+ * The score of a finished game, the empty squares going to the winner.
+ */
+static inline int finalScore(uint64_t me, uint64_t opp) {
+	int mine = popcount(me), theirs = popcount(opp);
+	int empty = 64 - mine - theirs;
+	if (mine > theirs) return mine - theirs + empty;
+	if (mine < theirs) return mine - theirs - empty;
+	return 0;
+}
+
+/*
+ * Starts the helper threads; the calling thread is the first of the given
+ * number, and searches along with them once it calls solve.
+ */
+EndgameSolver::EndgameSolver(int threads, int tableBits) :
+	table((size_t) 1 << tableBits), workers(threads < 1 ? 1 : threads) {
+	tableMask = ((uint64_t) 1 << tableBits) - 1;
+	version = 0;
+	quit = false;
+	idle = 0;
+	stop = false;
+	hasDeadline = false;
+	for (unsigned i = 0; i < workers.size(); i++) {
+		workers[i].nodes = 0;
+		workers[i].clockCountdown = CLOCK_CHECK;
+		// A thread only splits nodes on its own line of search, one per
+		// empty square at most, so solving never has to grow this
+		workers[i].splits.reserve(64);
+		workers[i].index = i;
+	}
+	for (unsigned i = 1; i < workers.size(); i++) {
+		helpers.push_back(std::thread(&EndgameSolver::help, this, i));
+	}
+}
+
+EndgameSolver::~EndgameSolver() {
+	{
+		std::lock_guard<std::mutex> guard(poolLock);
+		quit = true;
+	}
+	work.notify_all();
+	for (unsigned i = 0; i < helpers.size(); i++) helpers[i].join();
+}
+
+/*
+ * Reads the table without locking. An entry being written by another thread
+ * at the same time reads as a miss, as its three words do not agree: check
+ * covers both stone sets, so words from two positions with the same
+ * opponent's stones do not pass for either.
+ */
+void EndgameSolver::probe(uint64_t me, uint64_t opp, int *lower, int *upper, int *best) {
+	Entry *entry = &table[hash(me, opp) & tableMask];
+	uint64_t entryMe = __atomic_load_n(&entry->me, __ATOMIC_RELAXED);
+	uint64_t check = __atomic_load_n(&entry->check, __ATOMIC_RELAXED);
+	uint64_t data = __atomic_load_n(&entry->data, __ATOMIC_RELAXED);
+	if (entryMe != me || (check ^ data ^ me) != opp) {
+		*best = -1;
+		return;
+	}
+	*lower = (int) (data & 0xFF) - 64;
+	*upper = (int) ((data >> 8) & 0xFF) - 64;
+	*best = (int) ((data >> 16) & 0xFF) - 1;
+}
+
+void EndgameSolver::store(uint64_t me, uint64_t opp, int lower, int upper, int best) {
+	Entry *entry = &table[hash(me, opp) & tableMask];
+	uint64_t data = (uint64_t) (lower + 64) | (uint64_t) (upper + 64) << 8 | (uint64_t) (best + 1) << 16;
+	__atomic_store_n(&entry->me, me, __ATOMIC_RELAXED);
+	__atomic_store_n(&entry->check, me ^ opp ^ data, __ATOMIC_RELAXED);
+	__atomic_store_n(&entry->data, data, __ATOMIC_RELAXED);
+}
+
+/*
+ * Whether the search this thread is doing no longer matters: the whole
+ * solve was stopped, or a split point above it was cut off.
+ */
+bool EndgameSolver::cancelled(Worker &self, const SplitPoint *owner) {
+	if (stop.load(std::memory_order_relaxed)) return true;
+	return owner != NULL && owner->stopped();
+}
+
+int EndgameSolver::shallow(Worker &self, uint64_t me, uint64_t opp, int alpha, int beta, bool passed) {
+	self.nodes++;
+	uint64_t moves = moveMask(me, opp);
+	if (moves == 0) {
+		if (passed) return finalScore(me, opp);
+		return -shallow(self, opp, me, -beta, -alpha, true);
+	}
+	int best = -65;
+	for (; moves; moves &= moves - 1) {
+		int sq = __builtin_ctzll(moves);
+		uint64_t flips = flipMask(sq, me, opp);
+		int score = -shallow(self, opp & ~flips, me | flips | (1ULL << sq), -beta, -alpha, false);
+		if (score > best) {
+			best = score;
+			if (score > alpha) alpha = score;
+			if (alpha >= beta) break;
+		}
+	}
+	return best;
+}
+
+/*
+ * Negascout as in Solver, with the same move ordering, but once the first
+ * move of a deep enough node has been searched without a cutoff and some
+ * thread is idle, the rest of the moves are shared out at a split point.
+ * owner is the split point whose move this search is under, if any; when
+ * it or one above it is cut off, the search gives up and what it returns
+ * means nothing.
+ */
+int EndgameSolver::search(Worker &self, uint64_t me, uint64_t opp, int alpha, int beta, bool passed, SplitPoint *owner) {
+	int empty = 64 - popcount(me | opp);
+	if (empty < SHALLOW) return shallow(self, me, opp, alpha, beta, passed);
+	self.nodes++;
+	if (--self.clockCountdown == 0) {
+		self.clockCountdown = CLOCK_CHECK;
+		if (hasDeadline && std::chrono::steady_clock::now() > deadline) stop = true;
+	}
+	if (cancelled(self, owner)) return 0;
+	uint64_t moves = moveMask(me, opp);
+	if (moves == 0) {
+		if (passed) return finalScore(me, opp);
+		return -search(self, opp, me, -beta, -alpha, true, owner);
+	}
+
+	int lower, upper, hashMove;
+	probe(me, opp, &lower, &upper, &hashMove);
+	if (hashMove >= 0) {
+		if (lower >= beta) return lower;
+		if (upper <= alpha) return upper;
+		if (lower == upper) return lower;
+		if (lower > alpha) alpha = lower;
+		if (upper < beta) beta = upper;
+	}
+
+	// Fastest first: the fewer replies a move leaves, the sooner, a reply
+	// on a corner counting double and a move there being worth a few
+	int list[64], replies[64], numMoves = 0;
+	for (; moves; moves &= moves - 1) {
+		int sq = __builtin_ctzll(moves);
+		uint64_t flips = flipMask(sq, me, opp);
+		uint64_t after = moveMask(opp & ~flips, me | flips | (1ULL << sq));
+		int count = 2*(popcount(after) + popcount(after & CORNERS)) - (((1ULL << sq) & CORNERS) ? 3 : 0);
+		if (sq == hashMove) count = -1000;
+		int j = numMoves++;
+		for (; j > 0 && replies[j - 1] > count; j--) {
+			list[j] = list[j - 1];
+			replies[j] = replies[j - 1];
+		}
+		list[j] = sq;
+		replies[j] = count;
+	}
+
+	int alphaOrig = alpha, best = -65, bestMove = list[0];
+	for (int k = 0; k < numMoves; k++) {
+		// The eldest brother has been searched: split if anyone can help
+		if (k == 1 && empty >= SPLIT_EMPTIES && numMoves > 2 && idle.load(std::memory_order_relaxed) > 0) {
+			SplitPoint sp;
+			sp.parent = owner;
+			sp.me = me;
+			sp.opp = opp;
+			sp.beta = beta;
+			for (int i = 0; i < numMoves; i++) sp.moves[i] = list[i];
+			sp.numMoves = numMoves;
+			sp.cutoff = false;
+			sp.next = 1;
+			sp.working = 0;
+			sp.alpha = alpha;
+			sp.best = best;
+			sp.bestMove = bestMove;
+			{
+				std::lock_guard<std::mutex> guard(self.lock);
+				self.splits.push_back(&sp);
+			}
+			{
+				std::lock_guard<std::mutex> guard(poolLock);
+				version++;
+			}
+			work.notify_all();
+
+			// Take our own moves like any helper would
+			while (true) {
+				int claimed, claimAlpha;
+				{
+					std::lock_guard<std::mutex> guard(sp.lock);
+					if (sp.cutoff || sp.next >= sp.numMoves) break;
+					claimed = sp.next++;
+					claimAlpha = sp.alpha;
+					sp.working++;
+				}
+				searchSplitMove(self, &sp, claimed, claimAlpha);
+			}
+			{
+				std::lock_guard<std::mutex> guard(self.lock);
+				self.splits.pop_back();
+			}
+			// Wait for the moves others took, helping them finish meanwhile
+			while (true) {
+				{
+					std::lock_guard<std::mutex> guard(sp.lock);
+					if (sp.working == 0) break;
+				}
+				if (!steal(self, &sp)) std::this_thread::yield();
+			}
+			best = sp.best;
+			bestMove = sp.bestMove;
+			break;
+		}
+
+		int sq = list[k];
+		uint64_t flips = flipMask(sq, me, opp);
+		uint64_t nextMe = opp & ~flips, nextOpp = me | flips | (1ULL << sq);
+		int score;
+		if (k == 0) score = -search(self, nextMe, nextOpp, -beta, -alpha, false, owner);
+		else {
+			score = -search(self, nextMe, nextOpp, -alpha - 1, -alpha, false, owner);
+			if (score > alpha && score < beta) score = -search(self, nextMe, nextOpp, -beta, -score, false, owner);
+		}
+		if (cancelled(self, owner)) return 0;
+		if (score > best) {
+			best = score;
+			bestMove = sq;
+			if (score > alpha) alpha = score;
+			if (alpha >= beta) break;
+		}
+	}
+
+	if (cancelled(self, owner)) return 0;
+	store(me, opp, (best > alphaOrig) ? best : -64, (best < beta) ? best : 64, bestMove);
+	return best;
+}
+
+/*
+ * Searches move k of a split point, claimed when the split point's alpha
+ * was the one given, and records how it did. The first search is with the
+ * null window that alpha gives, as in negascout. Other threads may have
+ * raised alpha since, so a move that beats the old alpha is searched again
+ * from the new one.
+ */
+void EndgameSolver::searchSplitMove(Worker &self, SplitPoint *sp, int k, int alpha) {
+	int sq = sp->moves[k];
+	uint64_t flips = flipMask(sq, sp->me, sp->opp);
+	uint64_t nextMe = sp->opp & ~flips, nextOpp = sp->me | flips | (1ULL << sq);
+	int score = -search(self, nextMe, nextOpp, -alpha - 1, -alpha, false, sp);
+	if (score > alpha && score < sp->beta && !cancelled(self, sp)) {
+		int now;
+		{
+			std::lock_guard<std::mutex> guard(sp->lock);
+			now = sp->alpha;
+		}
+		if (now < sp->beta) score = -search(self, nextMe, nextOpp, -sp->beta, -now, false, sp);
+	}
+
+	std::lock_guard<std::mutex> guard(sp->lock);
+	if (!cancelled(self, sp) && score > sp->best) {
+		sp->best = score;
+		sp->bestMove = sq;
+		if (score > sp->alpha) sp->alpha = score;
+		// Everyone still on a brother of this move stops
+		if (sp->alpha >= sp->beta) sp->cutoff = true;
+	}
+	sp->working--;
+}
+
+/*
+ * Takes a move from the oldest open split point of another thread and
+ * searches it, returning whether there was one. A thread waiting at a
+ * split point only takes moves from below it, so that it is free as soon
+ * as its own split point is done.
+ */
+bool EndgameSolver::steal(Worker &self, const SplitPoint *within) {
+	for (unsigned i = 1; i < workers.size(); i++) {
+		Worker &victim = workers[(self.index + i) % workers.size()];
+		SplitPoint *taken = NULL;
+		int claimed = 0, claimAlpha = 0;
+		{
+			std::lock_guard<std::mutex> guard(victim.lock);
+			for (unsigned j = 0; j < victim.splits.size() && taken == NULL; j++) {
+				SplitPoint *sp = victim.splits[j];
+				if (within != NULL && (sp == within || !sp->below(within))) continue;
+				if (sp->stopped()) continue;
+				std::lock_guard<std::mutex> spGuard(sp->lock);
+				if (sp->next >= sp->numMoves) continue;
+				taken = sp;
+				claimed = sp->next++;
+				claimAlpha = sp->alpha;
+				sp->working++;
+			}
+		}
+		if (taken != NULL) {
+			searchSplitMove(self, taken, claimed, claimAlpha);
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+ * What each helper thread does: steal work while there is any, and sleep
+ * until a new split point is made when there is none.
+ */
+void EndgameSolver::help(int index) {
+	Worker &self = workers[index];
+	while (true) {
+		long seen;
+		{
+			std::lock_guard<std::mutex> guard(poolLock);
+			if (quit) return;
+			seen = version;
+		}
+		if (steal(self, NULL)) continue;
+		std::unique_lock<std::mutex> guard(poolLock);
+		idle++;
+		work.wait(guard, [&] { return quit || version != seen; });
+		idle--;
+	}
+}
+
+/*
+ * The exact score of the position for the player owning me, or if it is
+ * outside the window alpha to beta, a bound on it on that side. Gives up
+ * when stop is set or the deadline passes, returning nothing useful; stop
+ * stays set, so the caller can tell, until the caller clears it.
+ */
+int EndgameSolver::solve(uint64_t me, uint64_t opp, int alpha, int beta) {
+	return search(workers[0], me, opp, alpha, beta, false, NULL);
+}
+
+/*
+ * The best move for the player owning me, or -1 to pass; the exact
+ * score is put in score. Also -1 if the solve was stopped or ran out of
+ * time, as then nothing it found can be trusted.
+ */
+int EndgameSolver::bestMove(uint64_t me, uint64_t opp, int *score) {
+	stop = false;
+	uint64_t moves = moveMask(me, opp);
+	*score = solve(me, opp);
+	if (moves == 0 || stop) return -1;
+	// Searched deeply enough to be stored, the table knows the move
+	int lower, upper, best;
+	probe(me, opp, &lower, &upper, &best);
+	if (best >= 0) return best;
+	int bestSquare = -1, bestScore = -65;
+	for (; moves; moves &= moves - 1) {
+		int sq = __builtin_ctzll(moves);
+		uint64_t flips = flipMask(sq, me, opp);
+		int s = -solve(opp & ~flips, me | flips | (1ULL << sq));
+		if (stop) return -1;
+		if (s > bestScore) {
+			bestScore = s;
+			bestSquare = sq;
+		}
+	}
+	return bestSquare;
+}
+
+/*
+ * Nodes searched by all the threads since the solver was made.
+ */
+long EndgameSolver::nodes() {
+	long total = 0;
+	for (unsigned i = 0; i < workers.size(); i++) total += workers[i].nodes;
+	return total;
+}
+
+void EndgameSolver::clear() {
+	std::fill(table.begin(), table.end(), Entry());
+}
@@ -0,0 +1,111 @@
+#ifndef __ENDGAME_H__
+#define __ENDGAME_H__
+
+#include <cstdint>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+
+/**
+ * Exact endgame solver for the 8x8 board that searches on several threads
+ * at once, splitting the tree the young brothers wait way. At a node with
+ * enough empty squares the first move is searched alone, and only if it
+ * does not cut the node off are the rest offered to idle threads, at a
+ * split point. Each thread keeps the split points it made in a deque, and
+ * an idle thread steals a move from the oldest split point of another,
+ * which has the most work left below it. A move that cuts a split point
+ * off stops every move still being searched below it. The threads share
+ * one lockless transposition table.
+ */
+class EndgameSolver {
+	// One stored result. check is both stone sets xor data, so an entry
+	// half written by another thread does not match.
+	struct Entry
+	{
+		uint64_t me;
+		uint64_t check;
+		uint64_t data;
+	};
+
+	struct SplitPoint
+	{
+		SplitPoint *parent;
+		uint64_t me, opp;
+		int beta;
+		int moves[64];
+		int numMoves;
+		std::atomic<bool> cutoff;
+		// The rest only under lock: the next move to hand out, how many
+		// are being searched, and the best found so far
+		std::mutex lock;
+		int next;
+		int working;
+		int alpha;
+		int best;
+		int bestMove;
+		bool stopped() const {
+			for (const SplitPoint *sp = this; sp != NULL; sp = sp->parent) {
+				if (sp->cutoff.load(std::memory_order_relaxed)) return true;
+			}
+			return false;
+		}
+		bool below(const SplitPoint *other) const {
+			for (const SplitPoint *sp = this; sp != NULL; sp = sp->parent) {
+				if (sp == other) return true;
+			}
+			return false;
+		}
+	};
+
+	// A thread's split points, oldest first, the nodes it searched and
+	// how many more calls of search() until it looks at the clock
+	struct Worker
+	{
+		std::mutex lock;
+		std::vector<SplitPoint *> splits;
+		long nodes;
+		int clockCountdown;
+		int index;
+	};
+
+	std::vector<Entry> table;
+	uint64_t tableMask;
+	std::vector<Worker> workers;
+	std::vector<std::thread> helpers;
+	// Idle helpers wait for a new split point to be published
+	std::mutex poolLock;
+	std::condition_variable work;
+	long version;
+	bool quit;
+	std::atomic<int> idle;
+
+	void probe(uint64_t me, uint64_t opp, int *lower, int *upper, int *best);
+	void store(uint64_t me, uint64_t opp, int lower, int upper, int best);
+	bool cancelled(Worker &self, const SplitPoint *owner);
+	int shallow(Worker &self, uint64_t me, uint64_t opp, int alpha, int beta, bool passed);
+	int search(Worker &self, uint64_t me, uint64_t opp, int alpha, int beta, bool passed, SplitPoint *owner);
+	void searchSplitMove(Worker &self, SplitPoint *sp, int k, int alpha);
+	bool steal(Worker &self, const SplitPoint *within);
+	void help(int index);
+
+public:
+	// Stops the running solve, from any thread or at the deadline; the
+	// score it returns then means nothing. Only bestMove clears it.
+	std::atomic<bool> stop;
+	bool hasDeadline;
+	std::chrono::steady_clock::time_point deadline;
+
+	// A table of 2 to the tableBits entries
+	EndgameSolver(int threads, int tableBits = 22);
+	~EndgameSolver();
+	int solve(uint64_t me, uint64_t opp, int alpha = -64, int beta = 64);
+	int bestMove(uint64_t me, uint64_t opp, int *score);
+	long nodes();
+	void clear();
+	int threads() { return workers.size(); }
+};
+
+#endif
@@ -0,0 +1,462 @@
+#include "eval.h"
+#include "bitboard.h"
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <climits>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#define CORNER_SQUARES 0x8100000000000081ULL
+// The edge squares that are neither corners nor next to one
+#define EDGE_SQUARES 0x3C0081818181003CULL
+
+static const char WEIGHTS_MAGIC[8] = {'E', 'E', 'Y', 'W', 'E', 'I', 'G', 'H'};
+// Bumped whenever the features change, so old weight files are refused
+#define WEIGHTS_VERSION 2
+
+/*
+ * The hand picked weights: discs and corners only at the very end,
+ * everything else before that.
+ */
+void defaultWeights(EvalWeights *weights) {
+	static const int endgame[NUM_FEATURES] = {40, 20, 0, 0, 0, 0, 0, 0};
+	static const int midgame[NUM_FEATURES] = {1, 35, -20, -8, 10, 20, 5, 5};
+	for (int p = 0; p < NUM_PHASES; p++) {
+		for (int f = 0; f < NUM_FEATURES; f++) {
+			weights->w[p][f] = (p == 0) ? endgame[f] : midgame[f];
+		}
+	}
+	calibrateLazy(weights);
+}
+
+/*
+ * Fills scores with a basic score for owning each square. Corners have the
+ * highest score, edges also have high score, boxes next to edges and
+ * corners have lower scores.
+ */
+void squareWeights(int *scores) {
+	for (int i = 0; i < 64; i++) {
+		scores[i] = 1;
+		if (i % 8 == 0 || i % 8 == 7) scores[i] *= 3;
+		if (i < 8 || i > 55) scores[i] *= 3;
+		if ((i/8 == 2 || i/8 == 5) && !(i == 16 || i == 23 || i == 40 || i == 47)) scores[i] = -2*abs(scores[i]);
+		if ((i%8 == 2 || i%8 == 5) && !(i == 2 || i == 58 || i == 61 || i == 5)) scores[i] = -2*abs(scores[i]);
+		if (i/8 == 1 || i/8 == 6) scores[i] = -5*abs(scores[i]);
+		if (i % 8 == 1 || i % 8 == 6) scores[i] = -5*abs(scores[i]);
+	}
+	scores[9] *= 3;
+	scores[14] *= 3;
+	scores[49] *= 3;
+	scores[54] *= 3;
+}
+
+/*
+ * One shared copy of the hand picked weights, for boards that are not given
+ * any others.
+ */
+struct StandardWeights {
+	EvalWeights weights;
+	StandardWeights() {
+		defaultWeights(&weights);
+	}
+};
+
+const EvalWeights *standardWeights() {
+	static StandardWeights standard;
+	return &standard.weights;
+}
+
+/*
+ * Reads weights written by saveWeights (normally by the tuner). Returns
+ * false, leaving the weights alone, if the file is missing or was written
+ * for a different set of features.
+ */
+bool loadWeights(const char *file, EvalWeights *weights) {
+	FILE *in = fopen(file, "rb");
+	if (in == NULL) return false;
+	char magic[8];
+	uint32_t dims[3];
+	EvalWeights read;
+	bool ok = fread(magic, 8, 1, in) == 1 && memcmp(magic, WEIGHTS_MAGIC, 8) == 0 &&
+		fread(dims, sizeof(dims), 1, in) == 1 && dims[0] == WEIGHTS_VERSION &&
+		dims[1] == NUM_PHASES && dims[2] == NUM_FEATURES;
+	for (int p = 0; ok && p < NUM_PHASES; p++) {
+		int32_t row[NUM_FEATURES];
+		ok = fread(row, sizeof(row), 1, in) == 1;
+		for (int f = 0; ok && f < NUM_FEATURES; f++) read.w[p][f] = row[f];
+	}
+	fclose(in);
+	if (ok) {
+		calibrateLazy(&read);
+		*weights = read;
+	}
+	return ok;
+}
+
+/*
+ * Writes the weights as the magic, a version, the phase and feature counts
+ * and then little endian int32 weights, phase by phase.
+ */
+bool saveWeights(const char *file, const EvalWeights *weights) {
+	FILE *out = fopen(file, "wb");
+	if (out == NULL) return false;
+	uint32_t dims[3] = {WEIGHTS_VERSION, NUM_PHASES, NUM_FEATURES};
+	bool ok = fwrite(WEIGHTS_MAGIC, 8, 1, out) == 1 && fwrite(dims, sizeof(dims), 1, out) == 1;
+	for (int p = 0; ok && p < NUM_PHASES; p++) {
+		int32_t row[NUM_FEATURES];
+		for (int f = 0; f < NUM_FEATURES; f++) row[f] = weights->w[p][f];
+		ok = fwrite(row, sizeof(row), 1, out) == 1;
+	}
+	return (fclose(out) == 0) && ok;
+}
+
+/*
+ * A 64 bit FNV-1a hash of the weights, which tells apart caches of scores
+ * from different evaluations. The lazy margins follow from the weights, so
+ * they are left out.
+ */
+uint64_t weightsHash(const EvalWeights *weights) {
+	uint64_t h = 0xCBF29CE484222325ULL;
+	for (int p = 0; p < NUM_PHASES; p++)
+		for (int f = 0; f < NUM_FEATURES; f++) {
+			h ^= (uint32_t) weights->w[p][f];
+			h *= 0x100000001B3ULL;
+		}
+	return h;
+}
+
+/*
+ * The phase of the game, from how many squares are still open.
+ */
+static inline int phaseOf(int numOpen) {
+	if (numOpen < 6) return 0;
+	if (numOpen < 26) return 1;
+	if (numOpen < 46) return 2;
+	return 3;
+}
+
+int evalPhase(uint64_t me, uint64_t opp) {
+	return phaseOf(popcount(~(me | opp)));
+}
+
+
+/*
+ * The features that only take a few masks and popcounts: discs, corners,
+ * X and C squares and edges.
+ */
+static inline void cheapFeatures(uint64_t me, uint64_t opp, int *features) {
+	uint64_t emptyCorners = ~(me | opp) & CORNER_SQUARES;
+	// Only corners are at the ends of both diagonals, so the diagonal
+	// neighbours of corners are the X squares and the others the C squares
+	uint64_t xSquares = ((emptyCorners << 9) & ~FILE_A) | ((emptyCorners << 7) & ~FILE_H) |
+		((emptyCorners >> 7) & ~FILE_A) | ((emptyCorners >> 9) & ~FILE_H);
+	uint64_t cSquares = ((emptyCorners << 1) & ~FILE_A) | ((emptyCorners >> 1) & ~FILE_H) |
+		(emptyCorners << 8) | (emptyCorners >> 8);
+	features[F_DISCS] = popcount(me) - popcount(opp);
+	features[F_CORNERS] = popcount(me & CORNER_SQUARES) - popcount(opp & CORNER_SQUARES);
+	features[F_XSQUARES] = popcount(me & xSquares) - popcount(opp & xSquares);
+	features[F_CSQUARES] = popcount(me & cSquares) - popcount(opp & cSquares);
+	features[F_EDGES] = popcount(me & EDGE_SQUARES) - popcount(opp & EDGE_SQUARES);
+}
+
+/*
+ * The features that scan the whole board: mobility, potential mobility and
+ * frontier stones.
+ */
+static inline void costlyFeatures(uint64_t me, uint64_t opp, int *features) {
+	uint64_t empty = ~(me | opp);
+	uint64_t nextToEmpty = neighbours(empty);
+	features[F_MOBILITY] = popcount(moveMask(me, opp)) - popcount(moveMask(opp, me));
+	features[F_POTENTIAL] = popcount(neighbours(opp) & empty) - popcount(neighbours(me) & empty);
+	features[F_FRONTIER] = popcount(opp & nextToEmpty) - popcount(me & nextToEmpty);
+}
+
+/*
+ * The part of the score the cheap features make up.
+ */
+static inline int cheapScore(const int *w, const int *features) {
+	int score = 0;
+	for (int f = 0; f < FIRST_COSTLY; f++) score += w[f] * features[f];
+	return score;
+}
+
+static inline int costlyScore(const int *w, const int *features) {
+	int score = 0;
+	for (int f = FIRST_COSTLY; f < NUM_FEATURES; f++) score += w[f] * features[f];
+	return score;
+}
+
+/*
+ * Counts up every feature for the player owning me.
+ */
+void evalFeatures(uint64_t me, uint64_t opp, int *features) {
+	cheapFeatures(me, opp, features);
+	costlyFeatures(me, opp, features);
+}
+
+/*
+ * Scores the position for the player owning me.
+ */
+int evaluate(const EvalWeights *weights, uint64_t me, uint64_t opp) {
+	int features[NUM_FEATURES];
+	evalFeatures(me, opp, features);
+	const int *w = weights->w[evalPhase(me, opp)];
+	int score = 0;
+	for (int f = 0; f < NUM_FEATURES; f++) score += w[f] * features[f];
+	return score;
+}
+
+/*
+ * Like evaluate, but only exact inside the window alpha to beta. The cheap
+ * features are counted first, and if even the most the others were seen
+ * to add (weights->lazyMargin) cannot bring the score into the window,
+ * that bound is returned without the costly ones: at most alpha if the
+ * score is below the window and at least beta if above.
+ */
+int evaluateLazy(const EvalWeights *weights, uint64_t me, uint64_t opp, int alpha, int beta) {
+	int features[NUM_FEATURES];
+	cheapFeatures(me, opp, features);
+	int phase = evalPhase(me, opp);
+	const int *w = weights->w[phase];
+	int score = cheapScore(w, features);
+	int margin = weights->lazyMargin[phase];
+	if (score + margin <= alpha) return score + margin;
+	if (score - margin >= beta) return score - margin;
+	costlyFeatures(me, opp, features);
+	return score + costlyScore(w, features);
+}
+
+/*
+ * Finds lazyMargin for each phase: the most the costly terms add to or
+ * take from the score in the positions of a few thousand
+ * seeded random games, and an eighth more to be safe.
+ */
+void calibrateLazy(EvalWeights *weights) {
+	for (int p = 0; p < NUM_PHASES; p++) weights->lazyMargin[p] = 0;
+	uint64_t rng = 0x9E3779B97F4A7C15ULL;
+	for (int game = 0; game < 2000; game++) {
+		uint64_t me = 0x0000000810000000ULL, opp = 0x0000001008000000ULL;
+		int passes = 0;
+		while (passes < 2) {
+			uint64_t moves = moveMask(me, opp);
+			if (moves) {
+				rng ^= rng << 13;
+				rng ^= rng >> 7;
+				rng ^= rng << 17;
+				// Any of the legal moves, more or less evenly
+				int pick = (int) ((rng >> 32) % popcount(moves));
+				for (; pick > 0; pick--) moves &= moves - 1;
+				int sq = __builtin_ctzll(moves);
+				uint64_t flips = flipMask(sq, me, opp);
+				me |= flips | (1ULL << sq);
+				opp &= ~flips;
+				passes = 0;
+			}
+			else passes++;
+			uint64_t t = me;
+			me = opp;
+			opp = t;
+			int features[NUM_FEATURES];
+			costlyFeatures(me, opp, features);
+			int phase = evalPhase(me, opp);
+			const int *w = weights->w[phase];
+			int costly = abs(costlyScore(w, features));
+			if (costly > weights->lazyMargin[phase]) weights->lazyMargin[phase] = costly;
+		}
+	}
+	for (int p = 0; p < NUM_PHASES; p++) weights->lazyMargin[p] += weights->lazyMargin[p] / 8;
+}
+
+#ifdef __AVX2__
+/*
+ * The four lane versions of the bitboard helpers: every 64 bit lane is a
+ * board of its own.
+ */
+static inline __m256i popcount4(__m256i b) {
+	// Count each nibble by table lookup, then add up the bytes of each lane
+	const __m256i table = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+		0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+	const __m256i nibble = _mm256_set1_epi8(0x0F);
+	__m256i low = _mm256_shuffle_epi8(table, _mm256_and_si256(b, nibble));
+	__m256i high = _mm256_shuffle_epi8(table, _mm256_and_si256(_mm256_srli_epi64(b, 4), nibble));
+	return _mm256_sad_epu8(_mm256_add_epi8(low, high), _mm256_setzero_si256());
+}
+
+static inline __m256i shiftDir4(__m256i b, int d) {
+	const __m256i notA = _mm256_set1_epi64x((long long) ~FILE_A);
+	const __m256i notH = _mm256_set1_epi64x((long long) ~FILE_H);
+	switch (d) {
+		case DIR_E: return _mm256_and_si256(_mm256_slli_epi64(b, 1), notA);
+		case DIR_W: return _mm256_and_si256(_mm256_srli_epi64(b, 1), notH);
+		case DIR_S: return _mm256_slli_epi64(b, 8);
+		case DIR_N: return _mm256_srli_epi64(b, 8);
+		case DIR_SE: return _mm256_and_si256(_mm256_slli_epi64(b, 9), notA);
+		case DIR_SW: return _mm256_and_si256(_mm256_slli_epi64(b, 7), notH);
+		case DIR_NE: return _mm256_and_si256(_mm256_srli_epi64(b, 7), notA);
+		default: return _mm256_and_si256(_mm256_srli_epi64(b, 9), notH);
+	}
+}
+
+static inline __m256i movesAlong4(__m256i me, __m256i opp, int dir) {
+	__m256i left = _mm256_and_si256(opp, _mm256_slli_epi64(me, dir));
+	left = _mm256_or_si256(left, _mm256_and_si256(opp, _mm256_slli_epi64(left, dir)));
+	__m256i preLeft = _mm256_and_si256(opp, _mm256_slli_epi64(opp, dir));
+	left = _mm256_or_si256(left, _mm256_and_si256(preLeft, _mm256_slli_epi64(left, 2*dir)));
+	left = _mm256_or_si256(left, _mm256_and_si256(preLeft, _mm256_slli_epi64(left, 2*dir)));
+
+	__m256i right = _mm256_and_si256(opp, _mm256_srli_epi64(me, dir));
+	right = _mm256_or_si256(right, _mm256_and_si256(opp, _mm256_srli_epi64(right, dir)));
+	__m256i preRight = _mm256_and_si256(opp, _mm256_srli_epi64(opp, dir));
+	right = _mm256_or_si256(right, _mm256_and_si256(preRight, _mm256_srli_epi64(right, 2*dir)));
+	right = _mm256_or_si256(right, _mm256_and_si256(preRight, _mm256_srli_epi64(right, 2*dir)));
+
+	return _mm256_or_si256(_mm256_slli_epi64(left, dir), _mm256_srli_epi64(right, dir));
+}
+
+static inline __m256i moveMask4(__m256i me, __m256i opp) {
+	__m256i inner = _mm256_and_si256(opp, _mm256_set1_epi64x((long long) INNER_COLUMNS));
+	__m256i moves = _mm256_or_si256(_mm256_or_si256(movesAlong4(me, inner, 1), movesAlong4(me, opp, 8)),
+		_mm256_or_si256(movesAlong4(me, inner, 7), movesAlong4(me, inner, 9)));
+	return _mm256_andnot_si256(_mm256_or_si256(me, opp), moves);
+}
+
+static inline __m256i neighbours4(__m256i b) {
+	const __m256i notA = _mm256_set1_epi64x((long long) ~FILE_A);
+	const __m256i notH = _mm256_set1_epi64x((long long) ~FILE_H);
+	__m256i sideways = _mm256_or_si256(_mm256_and_si256(_mm256_slli_epi64(b, 1), notA),
+		_mm256_and_si256(_mm256_srli_epi64(b, 1), notH));
+	__m256i row = _mm256_or_si256(b, sideways);
+	return _mm256_or_si256(sideways, _mm256_or_si256(_mm256_slli_epi64(row, 8), _mm256_srli_epi64(row, 8)));
+}
+
+// Our count of the squares in mask less theirs, lane by lane
+static inline __m256i difference4(__m256i mine, __m256i theirs, __m256i mask) {
+	return _mm256_sub_epi64(popcount4(_mm256_and_si256(mine, mask)), popcount4(_mm256_and_si256(theirs, mask)));
+}
+
+/*
+ * Counts up the cheap features of four positions at once, lane by lane the
+ * same as cheapFeatures, along with the open squares that decide the phase.
+ */
+static void cheapFeatures4(const uint64_t *me, const uint64_t *opp, int features[4][NUM_FEATURES], int *numOpen) {
+	__m256i mine = _mm256_loadu_si256((const __m256i *) me);
+	__m256i theirs = _mm256_loadu_si256((const __m256i *) opp);
+	__m256i empty = _mm256_xor_si256(_mm256_or_si256(mine, theirs), _mm256_set1_epi64x(-1));
+	__m256i corners = _mm256_set1_epi64x((long long) CORNER_SQUARES);
+	__m256i emptyCorners = _mm256_and_si256(empty, corners);
+	__m256i xSquares = _mm256_or_si256(
+		_mm256_or_si256(shiftDir4(emptyCorners, DIR_SE), shiftDir4(emptyCorners, DIR_SW)),
+		_mm256_or_si256(shiftDir4(emptyCorners, DIR_NE), shiftDir4(emptyCorners, DIR_NW)));
+	__m256i cSquares = _mm256_or_si256(
+		_mm256_or_si256(shiftDir4(emptyCorners, DIR_E), shiftDir4(emptyCorners, DIR_W)),
+		_mm256_or_si256(shiftDir4(emptyCorners, DIR_S), shiftDir4(emptyCorners, DIR_N)));
+
+	alignas(32) int64_t lanes[FIRST_COSTLY + 1][4];
+	__m256i all = _mm256_set1_epi64x(-1);
+	_mm256_store_si256((__m256i *) lanes[F_DISCS], difference4(mine, theirs, all));
+	_mm256_store_si256((__m256i *) lanes[F_CORNERS], difference4(mine, theirs, corners));
+	_mm256_store_si256((__m256i *) lanes[F_XSQUARES], difference4(mine, theirs, xSquares));
+	_mm256_store_si256((__m256i *) lanes[F_CSQUARES], difference4(mine, theirs, cSquares));
+	_mm256_store_si256((__m256i *) lanes[F_EDGES],
+		difference4(mine, theirs, _mm256_set1_epi64x((long long) EDGE_SQUARES)));
+	_mm256_store_si256((__m256i *) lanes[FIRST_COSTLY], popcount4(empty));
+	for (int i = 0; i < 4; i++) {
+		for (int f = 0; f < FIRST_COSTLY; f++) features[i][f] = (int) lanes[f][i];
+		numOpen[i] = (int) lanes[FIRST_COSTLY][i];
+	}
+}
+
+/*
+ * Counts up the costly features of four positions at once, lane by lane
+ * the same as costlyFeatures.
+ */
+static void costlyFeatures4(const uint64_t *me, const uint64_t *opp, int features[4][NUM_FEATURES]) {
+	__m256i mine = _mm256_loadu_si256((const __m256i *) me);
+	__m256i theirs = _mm256_loadu_si256((const __m256i *) opp);
+	__m256i empty = _mm256_xor_si256(_mm256_or_si256(mine, theirs), _mm256_set1_epi64x(-1));
+
+	__m256i mobility = _mm256_sub_epi64(popcount4(moveMask4(mine, theirs)), popcount4(moveMask4(theirs, mine)));
+	__m256i potential = _mm256_sub_epi64(popcount4(_mm256_and_si256(neighbours4(theirs), empty)),
+		popcount4(_mm256_and_si256(neighbours4(mine), empty)));
+	__m256i frontier = difference4(theirs, mine, neighbours4(empty));
+
+	alignas(32) int64_t lanes[3][4];
+	_mm256_store_si256((__m256i *) lanes[0], mobility);
+	_mm256_store_si256((__m256i *) lanes[1], potential);
+	_mm256_store_si256((__m256i *) lanes[2], frontier);
+	for (int i = 0; i < 4; i++) {
+		features[i][F_MOBILITY] = (int) lanes[0][i];
+		features[i][F_POTENTIAL] = (int) lanes[1][i];
+		features[i][F_FRONTIER] = (int) lanes[2][i];
+	}
+}
+
+/*
+ * Positions of a batch still waiting for their costly features, which are
+ * counted four at a time once there are enough of them.
+ */
+struct CostlyQueue
+{
+	int index[4];
+	const int *w[4];
+	uint64_t me[4], opp[4];
+	int size;
+};
+
+static void flushCostly(CostlyQueue *queue, int *scores) {
+	if (queue->size == 0) return;
+	for (int j = queue->size; j < 4; j++) queue->me[j] = queue->opp[j] = 0;
+	int features[4][NUM_FEATURES];
+	costlyFeatures4(queue->me, queue->opp, features);
+	for (int j = 0; j < queue->size; j++) scores[queue->index[j]] += costlyScore(queue->w[j], features[j]);
+	queue->size = 0;
+}
+#endif
+
+/*
+ * Scores count positions at once, scores[i] being what evaluateLazy gives
+ * me[i] against opp[i] for the window alpha to beta (INT_MIN to INT_MAX
+ * for exact scores). Built with AVX2, four positions share each vector so
+ * the work for siblings overlaps instead of running one after another;
+ * the positions that need the costly features are gathered up so those
+ * are counted four at a time as well.
+ */
+void evaluateBatch(const EvalWeights *weights, const uint64_t *me, const uint64_t *opp, int count,
+	int alpha, int beta, int *scores) {
+#ifdef __AVX2__
+	CostlyQueue queue;
+	queue.size = 0;
+	int features[4][NUM_FEATURES], numOpen[4];
+	for (int i = 0; i < count; i += 4) {
+		int n = (count - i < 4) ? count - i : 4;
+		// Pad the last few out to a whole vector with empty boards
+		uint64_t groupMe[4] = {0, 0, 0, 0}, groupOpp[4] = {0, 0, 0, 0};
+		for (int j = 0; j < n; j++) {
+			groupMe[j] = me[i + j];
+			groupOpp[j] = opp[i + j];
+		}
+		cheapFeatures4(groupMe, groupOpp, features, numOpen);
+		for (int j = 0; j < n; j++) {
+			int phase = phaseOf(numOpen[j]);
+			const int *w = weights->w[phase];
+			int score = cheapScore(w, features[j]);
+			int margin = weights->lazyMargin[phase];
+			if (score + margin <= alpha) scores[i + j] = score + margin;
+			else if (score - margin >= beta) scores[i + j] = score - margin;
+			else {
+				scores[i + j] = score;
+				queue.index[queue.size] = i + j;
+				queue.w[queue.size] = w;
+				queue.me[queue.size] = groupMe[j];
+				queue.opp[queue.size] = groupOpp[j];
+				if (++queue.size == 4) flushCostly(&queue, scores);
+			}
+		}
+	}
+	flushCostly(&queue, scores);
+#else
+	for (int i = 0; i < count; i++) scores[i] = evaluateLazy(weights, me[i], opp[i], alpha, beta);
+#endif
+}
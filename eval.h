@@ -0,0 +1,53 @@
+#ifndef __EVAL_H__
+#define __EVAL_H__
+
+#include <cstdint>
+
+/*
+ * The evaluation is a weighted sum of a few features of the position, with
+ * a separate set of weights for each phase of the game. The features are
+ * all differences between the player being evaluated for ("me") and the
+ * opponent.
+ */
+enum Feature {
+	F_DISCS,      // stones
+	F_CORNERS,    // corners
+	F_XSQUARES,   // stones diagonally next to an empty corner
+	F_CSQUARES,   // stones on the edge next to an empty corner
+	F_EDGES,      // stones on the four middle squares of each edge
+	F_MOBILITY,   // legal moves
+	F_POTENTIAL,  // empty squares next to the opponent's stones less ours
+	F_FRONTIER,   // the opponent's stones next to an empty square less ours
+	NUM_FEATURES
+};
+
+// Features from here on scan the whole board; the ones before are a few
+// masks and popcounts
+#define FIRST_COSTLY F_MOBILITY
+
+// Phase 0 is the last few empty squares, then the game gets younger
+#define NUM_PHASES 4
+
+struct EvalWeights
+{
+	int w[NUM_PHASES][NUM_FEATURES];
+	// Not saved: the most the costly terms are expected to add in each
+	// phase, as found by calibrateLazy
+	int lazyMargin[NUM_PHASES];
+};
+
+void squareWeights(int *scores);
+void defaultWeights(EvalWeights *weights);
+const EvalWeights *standardWeights();
+bool loadWeights(const char *file, EvalWeights *weights);
+bool saveWeights(const char *file, const EvalWeights *weights);
+uint64_t weightsHash(const EvalWeights *weights);
+int evalPhase(uint64_t me, uint64_t opp);
+void evalFeatures(uint64_t me, uint64_t opp, int *features);
+int evaluate(const EvalWeights *weights, uint64_t me, uint64_t opp);
+int evaluateLazy(const EvalWeights *weights, uint64_t me, uint64_t opp, int alpha, int beta);
+void calibrateLazy(EvalWeights *weights);
+void evaluateBatch(const EvalWeights *weights, const uint64_t *me, const uint64_t *opp, int count,
+	int alpha, int beta, int *scores);
+
+#endif
@@ -0,0 +1,30 @@
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include "evalcache.h"
+
+/*
+ * Allocates the table on a cache line boundary, so no entry straddles two
+ * lines.
+ */
+EvalCache::EvalCache(int entries) {
+	int bits = 0;
+	while (bits < 30 && (2 << bits) <= entries) bits++;
+	mask = ((uint64_t) 1 << bits) - 1;
+	void *memory = NULL;
+	if (posix_memalign(&memory, 64, (mask + 1) * sizeof(Entry)) != 0) throw std::bad_alloc();
+	table = (Entry *) memory;
+	clear();
+}
+
+EvalCache::~EvalCache() {
+	free(table);
+}
+
+/*
+ * Forgets every score. An empty slot reads as a score of 0 for whichever
+ * position has the key 0, as unlikely a match as any other.
+ */
+void EvalCache::clear() {
+	memset(table, 0, (mask + 1) * sizeof(Entry));
+}
@@ -0,0 +1,70 @@
+#ifndef __EVALCACHE_H__
+#define __EVALCACHE_H__
+
+#include <cstdint>
+
+/**
+ * Scores of positions already evaluated, so that a leaf reached again
+ * through a transposition costs a lookup instead of the mobility and
+ * frontier scans. Kept apart from the transposition table and small enough
+ * to stay in the L2 cache: direct mapped, each position having one slot,
+ * four to a 64 byte line. Reads and writes take no lock, so the searches of
+ * several threads can share one cache. An entry is two words, the second
+ * the score and the first the key xor the score, so a slot half written by
+ * another thread reads as a miss. Scores are for the player owning me with
+ * one set of weights; clear it when the weights change.
+ */
+class EvalCache {
+	struct Entry
+	{
+		uint64_t check;
+		uint64_t data;
+	};
+
+	Entry *table;
+	uint64_t mask;
+
+	static inline uint64_t mix(uint64_t h) {
+		h ^= h >> 33;
+		h *= 0xFF51AFD7ED558CCDULL;
+		h ^= h >> 33;
+		h *= 0xC4CEB9FE1A85EC53ULL;
+		return h ^ (h >> 33);
+	}
+
+	// The key is all there is to tell positions apart, so it must not
+	// collide more than chance would have it. Mixing one board into the
+	// other does that; adding their products would not, as a disc on the
+	// top row changes only the top few bits of either.
+	static inline uint64_t hash(uint64_t me, uint64_t opp) {
+		return mix(me ^ mix(opp ^ 0x9E3779B97F4A7C15ULL));
+	}
+
+public:
+	// The number of entries is rounded down to a power of two
+	EvalCache(int entries);
+	~EvalCache();
+
+	inline bool probe(uint64_t me, uint64_t opp, int *score) {
+		uint64_t key = hash(me, opp);
+		Entry *entry = &table[key & mask];
+		uint64_t check = __atomic_load_n(&entry->check, __ATOMIC_RELAXED);
+		uint64_t data = __atomic_load_n(&entry->data, __ATOMIC_RELAXED);
+		if ((check ^ data) != key) return false;
+		*score = (int32_t) (uint32_t) data;
+		return true;
+	}
+
+	inline void store(uint64_t me, uint64_t opp, int score) {
+		uint64_t key = hash(me, opp);
+		Entry *entry = &table[key & mask];
+		uint64_t data = (uint32_t) score;
+		__atomic_store_n(&entry->check, key ^ data, __ATOMIC_RELAXED);
+		__atomic_store_n(&entry->data, data, __ATOMIC_RELAXED);
+	}
+
+	void clear();
+	int size() { return (int) (mask + 1); }
+};
+
+#endif
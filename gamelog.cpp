@@ -0,0 +1,174 @@
+#include "gamelog.h"
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+
+/*
+ * Each game in the log is a 20 byte header, then numMoves move bytes, then
+ * numStats 12 byte stats records. All numbers are little endian.
+ *
+ *   bytes 0-3   "EEYG"
+ *   byte 4      format version (1)
+ *   byte 5      the engine's side (0 white, 1 black)
+ *   byte 6      numMoves
+ *   byte 7      numStats
+ *   byte 8      black discs at the end
+ *   byte 9      white discs at the end
+ *   bytes 10-11 unused
+ *   bytes 12-19 start time, seconds since 1970
+ *
+ * and each stats record is the time used in ms (4 bytes), nodes searched
+ * (4), score (2), depth (1) and an unused byte.
+ */
+#define HEADER_SIZE 20
+#define STATS_SIZE 12
+
+static void putLE(std::string &out, uint64_t v, int bytes) {
+	for (int i = 0; i < bytes; i++) out += (char) ((v >> (8*i)) & 0xFF);
+}
+
+static uint64_t getLE(const unsigned char *in, int bytes) {
+	uint64_t v = 0;
+	for (int i = 0; i < bytes; i++) v |= (uint64_t) in[i] << (8*i);
+	return v;
+}
+
+void GameRecord::start(int side) {
+	engineSide = side;
+	numMoves = 0;
+	numStats = 0;
+	blackDiscs = 2;
+	whiteDiscs = 2;
+	startTime = time(NULL);
+}
+
+void GameRecord::addMove(int square) {
+	if (numMoves < MAX_GAME_MOVES) moves[numMoves++] = square;
+}
+
+void GameRecord::addStats(uint32_t timeMs, int depth, int score, uint32_t nodes) {
+	if (numStats == MAX_GAME_MOVES) return;
+	MoveStats &s = stats[numStats++];
+	s.timeMs = timeMs;
+	s.depth = depth;
+	s.score = score;
+	s.nodes = nodes;
+}
+
+/*
+ * Turns a game into the bytes stored in the log.
+ */
+std::string encodeGame(const GameRecord &game) {
+	std::string out;
+	out.reserve(HEADER_SIZE + game.numMoves + STATS_SIZE * game.numStats);
+	out += "EEYG";
+	putLE(out, 1, 1);
+	putLE(out, game.engineSide, 1);
+	putLE(out, game.numMoves, 1);
+	putLE(out, game.numStats, 1);
+	putLE(out, game.blackDiscs, 1);
+	putLE(out, game.whiteDiscs, 1);
+	putLE(out, 0, 2);
+	putLE(out, game.startTime, 8);
+	out.append((const char *) game.moves, game.numMoves);
+	for (int i = 0; i < game.numStats; i++) {
+		putLE(out, game.stats[i].timeMs, 4);
+		putLE(out, game.stats[i].nodes, 4);
+		putLE(out, (uint16_t) game.stats[i].score, 2);
+		putLE(out, game.stats[i].depth, 1);
+		putLE(out, 0, 1);
+	}
+	return out;
+}
+
+/*
+ * Reads the next game of a log. Returns false at the end of the file or if
+ * the rest of the file is not a valid game.
+ */
+bool readGame(FILE *in, GameRecord *game) {
+	unsigned char header[HEADER_SIZE];
+	if (fread(header, HEADER_SIZE, 1, in) != 1) return false;
+	if (memcmp(header, "EEYG", 4) != 0 || header[4] != 1) return false;
+	game->engineSide = header[5];
+	game->numMoves = header[6];
+	game->numStats = header[7];
+	game->blackDiscs = header[8];
+	game->whiteDiscs = header[9];
+	game->startTime = getLE(header + 12, 8);
+	if (game->numMoves > MAX_GAME_MOVES || game->numStats > MAX_GAME_MOVES) return false;
+	if (fread(game->moves, 1, game->numMoves, in) != game->numMoves) return false;
+	for (int i = 0; i < game->numStats; i++) {
+		unsigned char s[STATS_SIZE];
+		if (fread(s, STATS_SIZE, 1, in) != 1) return false;
+		game->stats[i].timeMs = getLE(s, 4);
+		game->stats[i].nodes = getLE(s + 4, 4);
+		game->stats[i].score = (int16_t) getLE(s + 8, 2);
+		game->stats[i].depth = s[10];
+	}
+	return true;
+}
+
+GameLog::GameLog(const char *file) {
+	path = file;
+	closing = false;
+	writer = std::thread(&GameLog::writeLoop, this);
+}
+
+/*
+ * Writes out every game still queued before returning.
+ */
+GameLog::~GameLog() {
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		closing = true;
+	}
+	wake.notify_one();
+	writer.join();
+}
+
+/*
+ * Queues a finished game for the writer thread.
+ */
+void GameLog::append(const GameRecord &game) {
+	std::string bytes = encodeGame(game);
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		queue.push_back(bytes);
+	}
+	wake.notify_one();
+}
+
+/*
+ * Waits for queued games and appends them to the file, everything that has
+ * queued up in one write.
+ */
+void GameLog::writeLoop() {
+	std::unique_lock<std::mutex> guard(lock);
+	while (true) {
+		wake.wait(guard, [this] { return closing || !queue.empty(); });
+		if (queue.empty()) return;
+		std::string bytes;
+		while (!queue.empty()) {
+			bytes += queue.front();
+			queue.pop_front();
+		}
+		guard.unlock();
+
+		int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+		if (fd >= 0) {
+			// Keep each game in one piece when several engines share a log
+			flock(fd, LOCK_EX);
+			size_t done = 0;
+			while (done < bytes.size()) {
+				ssize_t n = write(fd, bytes.data() + done, bytes.size() - done);
+				if (n <= 0) break;
+				done += n;
+			}
+			flock(fd, LOCK_UN);
+			close(fd);
+		}
+		guard.lock();
+	}
+}
@@ -0,0 +1,79 @@
+#ifndef __GAMELOG_H__
+#define __GAMELOG_H__
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// A game has at most 60 moves plus passes
+#define MAX_GAME_MOVES 128
+// Move byte meaning the side to move passed
+#define PASS_MOVE 64
+// Disc count of a game whose end the engine did not see
+#define UNKNOWN_DISCS 0xFF
+
+/**
+ * What the engine's search did for one of its own moves.
+ */
+struct MoveStats
+{
+	uint32_t timeMs;
+	uint32_t nodes;
+	int16_t score;
+	uint8_t depth;
+};
+
+/**
+ * One game as seen by the engine. Every move of both sides is one byte,
+ * x + y*8 or PASS_MOVE, starting with black's first move; stats holds one
+ * entry for each move the engine itself made, in order. The result is the
+ * disc count at the end of the game, or UNKNOWN_DISCS for both sides if
+ * the last board the engine saw was not the end: the opponent made the
+ * last move, or the game was ended early.
+ */
+struct GameRecord
+{
+	uint8_t engineSide;
+	uint8_t numMoves;
+	uint8_t numStats;
+	uint8_t blackDiscs;
+	uint8_t whiteDiscs;
+	uint64_t startTime;
+	uint8_t moves[MAX_GAME_MOVES];
+	MoveStats stats[MAX_GAME_MOVES];
+
+	void start(int side);
+	void addMove(int square);
+	void addStats(uint32_t timeMs, int depth, int score, uint32_t nodes);
+};
+
+/**
+ * Appends finished games to a binary log file. Games are encoded by the
+ * caller's thread but written by a background thread, so a game ending
+ * never waits on the disk. Appends are made under an exclusive lock on the
+ * file, so several engines can share one log.
+ */
+class GameLog {
+	std::string path;
+	std::deque<std::string> queue;
+	std::mutex lock;
+	std::condition_variable wake;
+	bool closing;
+	std::thread writer;
+
+	void writeLoop();
+
+public:
+	GameLog(const char *file);
+	~GameLog();
+	void append(const GameRecord &game);
+};
+
+std::string encodeGame(const GameRecord &game);
+bool readGame(FILE *in, GameRecord *game);
+
+#endif
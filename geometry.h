@@ -0,0 +1,141 @@
+#ifndef __GEOMETRY_H__
+#define __GEOMETRY_H__
+
+#include <cstdint>
+#include <type_traits>
+#include "bitboard.h"
+
+/*
+ * Bitboards for a board of any even size N from 4 to 10. Square x, y is
+ * bit x + y*N; boards up to 8x8 fit in a uint64_t and larger ones take a
+ * 128 bit word. The masks are all worked out at compile time, and the 8x8
+ * instance hands its move generation to the kernels of bitboard.h, so it
+ * costs nothing over using those directly.
+ */
+
+__extension__ typedef unsigned __int128 uint128_t;
+
+template <int N>
+struct Geometry
+{
+	static_assert(N >= 4 && N <= 10 && N % 2 == 0, "boards are 4x4 to 10x10");
+
+	typedef typename std::conditional<(N*N <= 64), uint64_t, uint128_t>::type Word;
+
+	static const int SIZE = N;
+	static const int SQUARES = N*N;
+
+	static constexpr Word bit(int sq) {
+		return ((Word) 1) << sq;
+	}
+
+	static constexpr Word allSquares() {
+		Word all = 0;
+		for (int sq = 0; sq < N*N; sq++) all |= bit(sq);
+		return all;
+	}
+
+	static constexpr Word column(int x) {
+		Word col = 0;
+		for (int y = 0; y < N; y++) col |= bit(x + y*N);
+		return col;
+	}
+
+	static constexpr Word ALL = allSquares();
+	static constexpr Word FIRST_COLUMN = column(0);
+	static constexpr Word LAST_COLUMN = column(N - 1);
+	static constexpr Word CORNERS = bit(0) | bit(N - 1) | bit(N*N - N) | bit(N*N - 1);
+
+	// The squares past the first 64, on the boards that have any
+	static inline uint64_t high(Word b) {
+		return (N*N > 64) ? (uint64_t) (b >> (N*N > 64 ? 64 : 0)) : 0;
+	}
+
+	static inline int popcount(Word b) {
+		return __builtin_popcountll((uint64_t) b) + __builtin_popcountll(high(b));
+	}
+
+	static inline int lowestSquare(Word b) {
+		uint64_t low = (uint64_t) b;
+		if (N*N <= 64 || low != 0) return __builtin_ctzll(low);
+		return 64 + __builtin_ctzll(high(b));
+	}
+
+	/*
+	 * The four stones in the middle that every game starts with: black (me)
+	 * on the diagonal going up to the right.
+	 */
+	static constexpr Word startMe() {
+		return bit(N/2 + (N/2 - 1)*N) | bit(N/2 - 1 + (N/2)*N);
+	}
+
+	static constexpr Word startOpp() {
+		return bit(N/2 - 1 + (N/2 - 1)*N) | bit(N/2 + (N/2)*N);
+	}
+
+	/*
+	 * Moves every stone of b one square in direction d, the same directions
+	 * shiftDir uses, dropping the ones that fall off the board.
+	 */
+	static inline Word shift(Word b, int d) {
+		switch (d) {
+			case DIR_E: return (b << 1) & ~FIRST_COLUMN & ALL;
+			case DIR_W: return (b >> 1) & ~LAST_COLUMN;
+			case DIR_S: return (b << N) & ALL;
+			case DIR_N: return b >> N;
+			case DIR_SE: return (b << (N + 1)) & ~FIRST_COLUMN & ALL;
+			case DIR_SW: return (b << (N - 1)) & ~LAST_COLUMN & ALL;
+			case DIR_NE: return (b >> (N - 1)) & ~FIRST_COLUMN;
+			default: return (b >> (N + 1)) & ~LAST_COLUMN;
+		}
+	}
+
+	/*
+	 * All squares where the player owning me may legally move: in each
+	 * direction, runs of opp stones next to ours grown one step at a time,
+	 * up to the longest run that fits, N - 2.
+	 */
+	static inline Word moves(Word me, Word opp) {
+		Word moves = 0;
+		for (int d = 0; d < 8; d++) {
+			Word run = shift(me, d) & opp;
+			for (int step = 1; step < N - 2; step++) run |= shift(run, d) & opp;
+			moves |= shift(run, d);
+		}
+		return moves & ~(me | opp) & ALL;
+	}
+
+	/*
+	 * The opponent stones turned over when me plays on square sq.
+	 */
+	static inline Word flips(int sq, Word me, Word opp) {
+		Word flips = 0;
+		for (int d = 0; d < 8; d++) {
+			Word run = 0, at = shift(bit(sq), d);
+			while (at & opp) {
+				run |= at;
+				at = shift(at, d);
+			}
+			if (at & me) flips |= run;
+		}
+		return flips;
+	}
+};
+
+template <int N> constexpr typename Geometry<N>::Word Geometry<N>::ALL;
+template <int N> constexpr typename Geometry<N>::Word Geometry<N>::FIRST_COLUMN;
+template <int N> constexpr typename Geometry<N>::Word Geometry<N>::LAST_COLUMN;
+template <int N> constexpr typename Geometry<N>::Word Geometry<N>::CORNERS;
+
+// The usual board uses the kernels written for it
+template <>
+inline uint64_t Geometry<8>::moves(uint64_t me, uint64_t opp) {
+	return moveMask(me, opp);
+}
+
+template <>
+inline uint64_t Geometry<8>::flips(int sq, uint64_t me, uint64_t opp) {
+	return flipMask(sq, me, opp);
+}
+
+#endif
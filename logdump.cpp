@@ -0,0 +1,49 @@
+#include <cstdio>
+#include <cstdlib>
+#include "gamelog.h"
+
+/*
+ * Prints the games in a binary game log as text: a line describing each
+ * game, then one line per move. Moves are written as a column letter and a
+ * row number ("d3", x = 3 being column d and y = 2 row 3), with the search
+ * stats after the engine's own moves. A game whose end the engine did not
+ * see has the result "unknown".
+ */
+int main(int argc, char *argv[]) {
+	if (argc != 2) {
+		fprintf(stderr, "usage: %s logfile\n", argv[0]);
+		exit(-1);
+	}
+	FILE *in = fopen(argv[1], "rb");
+	if (in == NULL) {
+		fprintf(stderr, "cannot open %s\n", argv[1]);
+		exit(-1);
+	}
+
+	GameRecord *game = new GameRecord();
+	int number = 0;
+	while (readGame(in, game)) {
+		number++;
+		printf("game %d engine %s started %llu result ", number,
+			game->engineSide == 1 ? "black" : "white", (unsigned long long) game->startTime);
+		if (game->blackDiscs == UNKNOWN_DISCS) printf("unknown\n");
+		else printf("%d-%d\n", game->blackDiscs, game->whiteDiscs);
+		// Black moves first, and a pass still uses up a turn
+		int side = 1, stat = 0;
+		for (int i = 0; i < game->numMoves; i++) {
+			int m = game->moves[i];
+			printf("%3d %s ", i + 1, side == 1 ? "black" : "white");
+			if (m == PASS_MOVE) printf("pass");
+			else printf("%c%d  ", 'a' + m % 8, m / 8 + 1);
+			if (side == game->engineSide && stat < game->numStats) {
+				MoveStats &s = game->stats[stat++];
+				printf(" depth %d score %d nodes %u time %ums", s.depth, s.score, s.nodes, s.timeMs);
+			}
+			printf("\n");
+			side = 1 - side;
+		}
+	}
+	fclose(in);
+	delete game;
+	return 0;
+}
@@ -0,0 +1,281 @@
+#include "mcts.h"
+#include "bitboard.h"
+#include "eval.h"
+#include "playout.h"
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <thread>
+
+Mcts::Mcts(int capacity, int threads) {
+	// The whole arena is made up front, so nodes are handed out by bumping
+	// used rather than allocated one by one
+	nodes.resize(capacity);
+	used = 0;
+	root = NO_NODE;
+	this->threads = threads;
+	deterministic = false;
+	seed = 1;
+	searches = 0;
+	turn = 0;
+	halted = false;
+	exploration = 1.0;
+	bias = 1.0;
+	stop = false;
+
+	// Squares the basic square weights like best get a prior near 1
+	int weights[64];
+	squareWeights(weights);
+	int lo = weights[0], hi = weights[0];
+	for (int i = 1; i < 64; i++) {
+		if (weights[i] < lo) lo = weights[i];
+		if (weights[i] > hi) hi = weights[i];
+	}
+	for (int i = 0; i < 64; i++) squarePrior[i] = 1000 * (weights[i] - lo) / (hi - lo);
+}
+
+/*
+ * Takes a node from the arena, or returns NO_NODE if it is full.
+ */
+int Mcts::newNode(uint64_t me, uint64_t opp, int parent, int move) {
+	if (used == (int) nodes.size()) return NO_NODE;
+	MctsNode &n = nodes[used];
+	n.me = me;
+	n.opp = opp;
+	n.parent = parent;
+	n.firstChild = NO_NODE;
+	n.nextSibling = NO_NODE;
+	n.visits = 0;
+	n.wins = 0;
+	n.virtualLoss = 0;
+	n.prior = (move == MCTS_PASS) ? 0.5f : squarePrior[move] / 1000.0f;
+	n.move = move;
+	n.expanded = false;
+	n.terminal = moveMask(me, opp) == 0 && moveMask(opp, me) == 0;
+	return used++;
+}
+
+/*
+ * Gives node n one child for every legal move, or a single pass child if
+ * the side to move has none. Leaves n unexpanded if the arena is full.
+ */
+void Mcts::expand(int n) {
+	uint64_t me = nodes[n].me, opp = nodes[n].opp;
+	uint64_t moves = moveMask(me, opp);
+	int first = NO_NODE, last = NO_NODE;
+	if (moves == 0) {
+		first = newNode(opp, me, n, MCTS_PASS);
+		if (first == NO_NODE) return;
+	}
+	while (moves) {
+		int sq = __builtin_ctzll(moves);
+		moves &= moves - 1;
+		uint64_t flips = flipMask(sq, me, opp);
+		// The child is seen from the opponent's side, who moves next
+		int child = newNode(opp & ~flips, me | flips | (1ULL << sq), n, sq);
+		if (child == NO_NODE) {
+			// Give back the children made so far
+			if (first != NO_NODE) used = first;
+			return;
+		}
+		if (first == NO_NODE) first = child;
+		else nodes[last].nextSibling = child;
+		last = child;
+	}
+	nodes[n].firstChild = first;
+	nodes[n].expanded = true;
+}
+
+/*
+ * Picks the child of n with the best UCT score plus progressive bias.
+ */
+int Mcts::select(int n) {
+	int total = nodes[n].visits + nodes[n].virtualLoss;
+	double logTotal = log((double) total + 1);
+	int best = NO_NODE;
+	double bestScore = -1e300;
+	for (int c = nodes[n].firstChild; c != NO_NODE; c = nodes[c].nextSibling) {
+		const MctsNode &child = nodes[c];
+		int visits = child.visits + child.virtualLoss;
+		double score;
+		// Try every move once before trusting any average
+		if (visits == 0) score = 1e9 + child.prior;
+		else score = child.wins / visits + exploration * sqrt(logTotal / visits) +
+			bias * child.prior / (visits + 1);
+		if (score > bestScore) {
+			bestScore = score;
+			best = c;
+		}
+	}
+	return best;
+}
+
+/*
+ * Walks down the tree from the root to the node to play out from,
+ * expanding it if it has been visited before, and marks the path with
+ * virtual losses. The caller holds the tree.
+ */
+int Mcts::descend() {
+	int n = root;
+	nodes[n].virtualLoss++;
+	while (nodes[n].expanded && !nodes[n].terminal) {
+		n = select(n);
+		nodes[n].virtualLoss++;
+	}
+	if (!nodes[n].terminal && nodes[n].visits > 0) {
+		expand(n);
+		if (nodes[n].expanded) {
+			n = select(n);
+			nodes[n].virtualLoss++;
+		}
+	}
+	return n;
+}
+
+/*
+ * Adds the result of a playout from n, with disc difference diff for the
+ * side to move there, to n and everything above it. The caller holds the
+ * tree.
+ */
+void Mcts::backup(int n, int diff) {
+	// Each node's wins belong to the player who moved into it, who is
+	// the side not to move there
+	double result = (diff < 0) ? 1 : (diff == 0 ? 0.5 : 0);
+	while (n != NO_NODE) {
+		nodes[n].virtualLoss--;
+		nodes[n].visits++;
+		nodes[n].wins += result;
+		result = 1 - result;
+		n = nodes[n].parent;
+	}
+}
+
+/*
+ * One thread's share of the search: runs simulations until the playout
+ * count is used up or the time runs out.
+ */
+void Mcts::simulate(uint64_t seed, long playouts, double seconds) {
+	Xorshift rng(seed);
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (long done = 0; done < playouts && !stop.load(std::memory_order_relaxed); done++) {
+		if (seconds > 0 && (done & 15) == 0) {
+			std::chrono::duration<double> spent = std::chrono::steady_clock::now() - start;
+			if (spent.count() > seconds) break;
+		}
+
+		treeLock.lock();
+		int n = descend();
+		uint64_t me = nodes[n].me, opp = nodes[n].opp;
+		treeLock.unlock();
+
+		int diff = playout(me, opp, rng);
+
+		treeLock.lock();
+		backup(n, diff);
+		treeLock.unlock();
+	}
+}
+
+/*
+ * One thread's share of a deterministic search. Turn 2*threads*round +
+ * thread is this thread's walk down the tree in a round and threads turns
+ * later comes its backup, so the tree only ever changes in that order. The
+ * first thread decides for everyone, at its walk, whether to stop.
+ */
+void Mcts::simulateInTurn(int thread, uint64_t seed, long rounds, double seconds) {
+	Xorshift rng(seed);
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (long r = 0; r < rounds; r++) {
+		long mine = 2*threads*r + thread;
+		while (turn.load(std::memory_order_acquire) != mine) std::this_thread::yield();
+		if (thread == 0) {
+			std::chrono::duration<double> spent = std::chrono::steady_clock::now() - start;
+			halted = stop.load(std::memory_order_relaxed) || (seconds > 0 && spent.count() > seconds);
+		}
+		if (halted) {
+			turn.store(mine + 1, std::memory_order_release);
+			return;
+		}
+		int n = descend();
+		uint64_t me = nodes[n].me, opp = nodes[n].opp;
+		turn.store(mine + 1, std::memory_order_release);
+
+		int diff = playout(me, opp, rng);
+
+		mine += threads;
+		while (turn.load(std::memory_order_acquire) != mine) std::this_thread::yield();
+		backup(n, diff);
+		turn.store(mine + 1, std::memory_order_release);
+	}
+}
+
+/*
+ * A well mixed seed for thread t of search number search, from the seed
+ * of a deterministic search.
+ */
+static uint64_t threadSeed(uint64_t seed, long search, int t) {
+	uint64_t z = seed + (uint64_t) (search*1024 + t + 1) * 0x9E3779B97F4A7C15ULL;
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+/*
+ * Looks for the position at most plies moves below node from.
+ */
+int Mcts::findPosition(int from, uint64_t me, uint64_t opp, int plies) {
+	if (nodes[from].me == me && nodes[from].opp == opp) return from;
+	if (plies == 0) return NO_NODE;
+	for (int c = nodes[from].firstChild; c != NO_NODE; c = nodes[c].nextSibling) {
+		int found = findPosition(c, me, opp, plies - 1);
+		if (found != NO_NODE) return found;
+	}
+	return NO_NODE;
+}
+
+/*
+ * Searches the position where the side to move owns me, for the given
+ * number of playouts or (if ms is positive) milliseconds, and returns the
+ * square of the most visited move, or -1 if there is no legal move.
+ */
+int Mcts::search(uint64_t me, uint64_t opp, long playouts, int ms) {
+	if (moveMask(me, opp) == 0) return -1;
+
+	// Reuse the tree if this position is our move and the opponent's reply
+	// below the last root; start afresh if it is gone or the arena is
+	// mostly used up
+	int found = (root == NO_NODE) ? NO_NODE : findPosition(root, me, opp, 2);
+	if (found == NO_NODE || used > (int) nodes.size() / 2) {
+		used = 0;
+		root = newNode(me, opp, NO_NODE, MCTS_PASS);
+	}
+	else {
+		root = found;
+		nodes[root].parent = NO_NODE;
+	}
+	if (!nodes[root].expanded) expand(root);
+
+	std::vector<std::thread> workers;
+	long share = playouts / threads + 1;
+	if (deterministic) {
+		turn = 0;
+		halted = false;
+		for (int t = 1; t < threads; t++)
+			workers.push_back(std::thread(&Mcts::simulateInTurn, this, t, threadSeed(seed, searches, t), share, ms / 1000.0));
+		simulateInTurn(0, threadSeed(seed, searches, 0), share, ms / 1000.0);
+	}
+	else {
+		std::random_device seeder;
+		for (int t = 1; t < threads; t++)
+			workers.push_back(std::thread(&Mcts::simulate, this, ((uint64_t) seeder() << 32) ^ t, share, ms / 1000.0));
+		simulate(((uint64_t) seeder() << 32), share, ms / 1000.0);
+	}
+	for (size_t t = 0; t < workers.size(); t++) workers[t].join();
+	searches++;
+
+	int best = NO_NODE;
+	for (int c = nodes[root].firstChild; c != NO_NODE; c = nodes[c].nextSibling) {
+		if (best == NO_NODE || nodes[c].visits > nodes[best].visits) best = c;
+	}
+	return nodes[best].move;
+}
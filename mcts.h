@@ -0,0 +1,91 @@
+#ifndef __MCTS_H__
+#define __MCTS_H__
+
+#include <cstdint>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include "common.h"
+
+// Move stored in a node reached by passing
+#define MCTS_PASS 64
+// Index meaning "no node"
+#define NO_NODE -1
+
+/**
+ * A node of the search tree. Nodes live in one array and point at each
+ * other by index: a node's children are firstChild and the chain of
+ * nextSibling links from it.
+ */
+struct MctsNode
+{
+	// The position, with the side to move owning me
+	uint64_t me;
+	uint64_t opp;
+	int32_t parent;
+	int32_t firstChild;
+	int32_t nextSibling;
+	// Playouts through this node, and how many the player who moved into
+	// it won (a draw counts half)
+	int32_t visits;
+	float wins;
+	// Simulations currently passing through, each counted as a loss until
+	// it finishes, so parallel threads spread out over the tree
+	int32_t virtualLoss;
+	// Square weight prior for the move into this node, from 0 to 1
+	float prior;
+	uint8_t move;
+	bool expanded;
+	bool terminal;
+};
+
+/**
+ * Monte Carlo tree search with UCT and an optional progressive bias towards
+ * squares the basic square weights like. Several threads run simulations
+ * at once: tree changes are made under one lock, the random playouts
+ * outside it. The tree is kept between moves, so the part below the moves
+ * actually played is reused.
+ *
+ * A deterministic search instead takes turns: in every round each thread
+ * in order walks down the tree, then all play out at once, then each in
+ * order backs its result up. With the random numbers seeded from seed, the
+ * same positions searched for the same playouts grow the same trees and
+ * choose the same moves however the threads are scheduled.
+ */
+class Mcts {
+	std::vector<MctsNode> nodes;
+	int used;
+	int root;
+	std::mutex treeLock;
+	int squarePrior[64];
+
+	int newNode(uint64_t me, uint64_t opp, int parent, int move);
+	void expand(int n);
+	int select(int n);
+	int findPosition(int from, uint64_t me, uint64_t opp, int plies);
+	int descend();
+	void backup(int n, int diff);
+	void simulate(uint64_t seed, long playouts, double seconds);
+	// The next turn of a deterministic search, whether it has been cut
+	// short, and how many searches there have been
+	std::atomic<long> turn;
+	bool halted;
+	long searches;
+	void simulateInTurn(int thread, uint64_t seed, long rounds, double seconds);
+
+public:
+	// Exploration constant and the weight of the square prior
+	double exploration;
+	double bias;
+	int threads;
+	bool deterministic;
+	uint64_t seed;
+	// Set from any thread to end the running search early
+	std::atomic<bool> stop;
+
+	Mcts(int capacity, int threads);
+	int search(uint64_t me, uint64_t opp, long playouts, int ms);
+	int treeSize() { return used; }
+};
+
+#endif
@@ -0,0 +1,347 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <climits>
+#include <chrono>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "board.h"
+#include "eval.h"
+#include "gamelog.h"
+#include "playout.h"
+
+/*
+ * Micro-benchmarks of the board's hot primitives, to catch regressions the
+ * whole-search numbers of bench would blur:
+ *
+ *   microbench [--log file] [--games G] [--reps R] [--seed S]
+ *
+ * Every kernel is run over the same corpus of positions from played games:
+ * the games of a binary game log if one is given, or else G games the
+ * engine plays against itself at depth 2 after a few seeded random opening
+ * moves. Each kernel is warmed up with one pass over the corpus and then
+ * timed over R more. The output is one JSON object per line, first the
+ * corpus and then each kernel in a fixed order, so two runs can be diffed:
+ *
+ *   {"kernel": "...", "ops": n, "reps": r, "ns_per_op": mean,
+ *    "ns_stddev": sd, "ns_min": fastest, "cycles_per_op": mean}
+ *
+ * ops is the number of calls in one pass and the ns figures are per call
+ * over the passes. Cycles are time stamp counter ticks, which run at a
+ * fixed rate rather than the core's clock. The Board kernels set the
+ * position for every call, which setPosition on its own measures.
+ */
+
+struct MicroPosition
+{
+	uint64_t black, white;
+	Side toMove;
+};
+
+// Where the results go, so the compiler cannot drop the work
+static volatile long sink;
+
+static inline uint64_t cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+/*
+ * Adds the positions of one game to the corpus, from the start up to the
+ * last move. Returns false if a move is not legal.
+ */
+static bool replayGame(const GameRecord &game, std::vector<MicroPosition> &corpus) {
+	uint64_t me = 0x0000000810000000ULL, opp = 0x0000001008000000ULL;
+	Side side = BLACK;
+	for (int i = 0; i < game.numMoves; i++) {
+		MicroPosition pos;
+		pos.black = (side == BLACK) ? me : opp;
+		pos.white = (side == BLACK) ? opp : me;
+		pos.toMove = side;
+		corpus.push_back(pos);
+		int m = game.moves[i];
+		if (m != PASS_MOVE) {
+			if (!((moveMask(me, opp) >> m) & 1)) return false;
+			uint64_t flips = flipMask(m, me, opp);
+			me |= flips | (1ULL << m);
+			opp &= ~flips;
+		}
+		uint64_t t = me;
+		me = opp;
+		opp = t;
+		side = (side == BLACK) ? WHITE : BLACK;
+	}
+	return true;
+}
+
+/*
+ * Plays count games of the engine against itself, the first few moves of
+ * each at random, adding every position to the corpus.
+ */
+static void selfPlay(int count, uint64_t seed, std::vector<MicroPosition> &corpus) {
+	Xorshift rng(seed);
+	for (int g = 0; g < count; g++) {
+		uint64_t black = 0x0000000810000000ULL, white = 0x0000001008000000ULL;
+		Side side = BLACK;
+		int passes = 0, ply = 0;
+		while (passes < 2) {
+			uint64_t me = (side == BLACK) ? black : white, opp = (side == BLACK) ? white : black;
+			uint64_t moves = moveMask(me, opp);
+			Side other = (side == BLACK) ? WHITE : BLACK;
+			if (!moves) {
+				passes++;
+				side = other;
+				continue;
+			}
+			passes = 0;
+			MicroPosition pos = {black, white, side};
+			corpus.push_back(pos);
+			int sq;
+			if (ply++ < 6) sq = selectBit(moves, rng.below(popcount(moves)));
+			else {
+				Board board(side);
+				board.setPosition(black, white);
+				board.moves.push(-5);
+				board.negascout(2, -100000000, 100000000, 1, true, true, 0);
+				sq = board.moveToDo->getX() + 8*board.moveToDo->getY();
+				if (sq < 0 || !((moves >> sq) & 1)) sq = __builtin_ctzll(moves);
+			}
+			uint64_t flips = flipMask(sq, me, opp);
+			me |= flips | (1ULL << sq);
+			opp &= ~flips;
+			black = (side == BLACK) ? me : opp;
+			white = (side == BLACK) ? opp : me;
+			side = other;
+		}
+	}
+}
+
+/*
+ * Times pass, which makes one pass over the corpus and returns the number
+ * of calls it made, and prints the kernel's line.
+ */
+template <typename Pass>
+static void measure(const char *kernel, int reps, Pass pass) {
+	long ops = pass();
+	std::vector<double> ns(reps);
+	double totalCycles = 0;
+	for (int r = 0; r < reps; r++) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		uint64_t before = cycles();
+		pass();
+		uint64_t after = cycles();
+		std::chrono::duration<double, std::nano> spent = std::chrono::steady_clock::now() - start;
+		ns[r] = spent.count() / ops;
+		totalCycles += (double) (after - before) / ops;
+	}
+	double mean = 0, least = ns[0];
+	for (int r = 0; r < reps; r++) {
+		mean += ns[r] / reps;
+		if (ns[r] < least) least = ns[r];
+	}
+	double variance = 0;
+	for (int r = 0; r < reps; r++) variance += (ns[r] - mean) * (ns[r] - mean) / reps;
+	printf("{\"kernel\": \"%s\", \"ops\": %ld, \"reps\": %d, \"ns_per_op\": %.3f, \"ns_stddev\": %.3f, "
+		"\"ns_min\": %.3f, \"cycles_per_op\": %.2f}\n", kernel, ops, reps, mean, sqrt(variance), least,
+		totalCycles / reps);
+	fflush(stdout);
+}
+
+static void usage(const char *name) {
+	fprintf(stderr, "usage: %s [--log file] [--games G] [--reps R] [--seed S]\n", name);
+	exit(-1);
+}
+
+int main(int argc, char *argv[]) {
+	const char *logFile = NULL;
+	int games = 40, reps = 20;
+	uint64_t seed = 1;
+	for (int i = 1; i < argc; i += 2) {
+		if (i + 1 >= argc) usage(argv[0]);
+		if (!strcmp(argv[i], "--log")) logFile = argv[i + 1];
+		else if (!strcmp(argv[i], "--games")) games = atoi(argv[i + 1]);
+		else if (!strcmp(argv[i], "--reps")) reps = atoi(argv[i + 1]);
+		else if (!strcmp(argv[i], "--seed")) seed = strtoull(argv[i + 1], NULL, 10);
+		else usage(argv[0]);
+	}
+	if (reps < 1) reps = 1;
+
+	std::vector<MicroPosition> corpus;
+	int played = 0;
+	if (logFile != NULL) {
+		FILE *in = fopen(logFile, "rb");
+		if (in == NULL) {
+			fprintf(stderr, "cannot open %s\n", logFile);
+			return 1;
+		}
+		GameRecord *game = new GameRecord();
+		while (readGame(in, game)) {
+			if (replayGame(*game, corpus)) played++;
+		}
+		fclose(in);
+		delete game;
+	}
+	else {
+		selfPlay(games, seed, corpus);
+		played = games;
+	}
+	if (corpus.empty()) {
+		fprintf(stderr, "no positions to measure\n");
+		return 1;
+	}
+	int n = corpus.size();
+	printf("{\"corpus\": \"%s\", \"games\": %d, \"positions\": %d, \"avx2\": %s}\n",
+		logFile != NULL ? logFile : "self-play", played, n,
+#ifdef __AVX2__
+		"true"
+#else
+		"false"
+#endif
+		);
+
+	// Both sides of every position, as bitboards of the mover and the other,
+	// and every legal move of each
+	std::vector<uint64_t> mine(n), theirs(n);
+	std::vector<int> movePosition, moveSquare;
+	for (int i = 0; i < n; i++) {
+		mine[i] = (corpus[i].toMove == BLACK) ? corpus[i].black : corpus[i].white;
+		theirs[i] = (corpus[i].toMove == BLACK) ? corpus[i].white : corpus[i].black;
+		for (uint64_t m = moveMask(mine[i], theirs[i]); m; m &= m - 1) {
+			movePosition.push_back(i);
+			moveSquare.push_back(__builtin_ctzll(m));
+		}
+	}
+	int numMoves = moveSquare.size();
+	Board board(BLACK);
+	const EvalWeights *weights = standardWeights();
+
+	measure("setPosition", reps, [&]() {
+		long sum = 0;
+		for (int i = 0; i < n; i++) {
+			board.setPosition(corpus[i].black, corpus[i].white);
+			sum += board.numOpen;
+		}
+		sink = sum;
+		return (long) n;
+	});
+	measure("checkMove", reps, [&]() {
+		long sum = 0;
+		for (int i = 0; i < n; i++) {
+			board.setPosition(corpus[i].black, corpus[i].white);
+			for (int sq = 0; sq < 64; sq++) {
+				Move move(sq % 8, sq / 8);
+				sum += board.checkMove(&move, corpus[i].toMove);
+			}
+		}
+		sink = sum;
+		return 64L * n;
+	});
+	measure("hasMoves", reps, [&]() {
+		long sum = 0;
+		for (int i = 0; i < n; i++) {
+			board.setPosition(corpus[i].black, corpus[i].white);
+			sum += board.hasMoves(corpus[i].toMove);
+		}
+		sink = sum;
+		return (long) n;
+	});
+	measure("doMove+undoMove", reps, [&]() {
+		long sum = 0;
+		board.moves.size = 0;
+		board.moves.push(-5);
+		for (int k = 0; k < numMoves; k++) {
+			const MicroPosition &pos = corpus[movePosition[k]];
+			board.setPosition(pos.black, pos.white);
+			Move move(moveSquare[k] % 8, moveSquare[k] / 8);
+			board.doMove(&move, pos.toMove);
+			sum += board.getBlack() & 0xFF;
+			board.undoMove();
+		}
+		sink = sum;
+		return (long) numMoves;
+	});
+	measure("countBlack+countWhite", reps, [&]() {
+		long sum = 0;
+		for (int i = 0; i < n; i++) {
+			board.setPosition(corpus[i].black, corpus[i].white);
+			sum += board.countBlack() + board.countWhite();
+		}
+		sink = sum;
+		return (long) n;
+	});
+	measure("betterHeuristic", reps, [&]() {
+		long sum = 0;
+		for (int i = 0; i < n; i++) {
+			board.setPosition(corpus[i].black, corpus[i].white);
+			sum += board.betterHeuristic();
+		}
+		sink = sum;
+		return (long) n;
+	});
+	measure("boardRepresentation", reps, [&]() {
+		long sum = 0;
+		for (int i = 0; i < n; i++) {
+			board.setPosition(corpus[i].black, corpus[i].white);
+			sum += board.boardRepresentation()[27];
+		}
+		sink = sum;
+		return (long) n;
+	});
+	measure("hashFind", reps, [&]() {
+		long sum = 0;
+		for (int i = 0; i < n; i++) {
+			board.setPosition(corpus[i].black, corpus[i].white);
+			sum += board.hashFind();
+		}
+		sink = sum;
+		return (long) n;
+	});
+	measure("canonicalKey", reps, [&]() {
+		long sum = 0;
+		for (int i = 0; i < n; i++) {
+			board.setPosition(corpus[i].black, corpus[i].white);
+			int symmetry;
+			sum += board.canonicalKey(corpus[i].toMove, &symmetry) & 0xFF;
+		}
+		sink = sum;
+		return (long) n;
+	});
+	measure("moveMask", reps, [&]() {
+		uint64_t sum = 0;
+		for (int i = 0; i < n; i++) sum += moveMask(mine[i], theirs[i]);
+		sink = sum;
+		return (long) n;
+	});
+	measure("flipMask", reps, [&]() {
+		uint64_t sum = 0;
+		for (int k = 0; k < numMoves; k++) {
+			int i = movePosition[k];
+			sum += flipMask(moveSquare[k], mine[i], theirs[i]);
+		}
+		sink = sum;
+		return (long) numMoves;
+	});
+	measure("evaluate", reps, [&]() {
+		long sum = 0;
+		for (int i = 0; i < n; i++) sum += evaluate(weights, mine[i], theirs[i]);
+		sink = sum;
+		return (long) n;
+	});
+	measure("evaluateBatch", reps, [&]() {
+		static int scores[64];
+		long sum = 0;
+		for (int i = 0; i + 10 <= n; i += 10) {
+			evaluateBatch(weights, &mine[i], &theirs[i], 10, INT_MIN, INT_MAX, scores);
+			sum += scores[0];
+		}
+		sink = sum;
+		return (long) (n / 10 * 10);
+	});
+	return 0;
+}
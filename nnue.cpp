@@ -0,0 +1,191 @@
+#include "nnue.h"
+#include <cstdio>
+#include <cstring>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+static const char NNUE_MAGIC[8] = {'E', 'E', 'Y', 'N', 'N', 'U', 'E', '1'};
+
+/*
+ * Input number of a stone: black stones first, then white.
+ */
+static inline int inputOf(int square, Side side) {
+	return (side == BLACK) ? square : 64 + square;
+}
+
+/*
+ * Reads a network file: the magic, the three layer sizes as int32 (which
+ * must match this build), then w1, b1, w2, b2, w3, b3 and the output shift,
+ * all little endian in the order and shape of the members.
+ */
+bool Network::load(const char *file) {
+	FILE *in = fopen(file, "rb");
+	if (in == NULL) return false;
+	char magic[8];
+	int32_t dims[3];
+	bool ok = fread(magic, 8, 1, in) == 1 && memcmp(magic, NNUE_MAGIC, 8) == 0 &&
+		fread(dims, sizeof(dims), 1, in) == 1 && dims[0] == NNUE_INPUTS &&
+		dims[1] == NNUE_HIDDEN && dims[2] == NNUE_L2 &&
+		fread(w1, sizeof(w1), 1, in) == 1 && fread(b1, sizeof(b1), 1, in) == 1 &&
+		fread(w2, sizeof(w2), 1, in) == 1 && fread(b2, sizeof(b2), 1, in) == 1 &&
+		fread(w3, sizeof(w3), 1, in) == 1 && fread(&b3, sizeof(b3), 1, in) == 1 &&
+		fread(&outputShift, sizeof(outputShift), 1, in) == 1;
+	fclose(in);
+	return ok;
+}
+
+bool Network::save(const char *file) const {
+	FILE *out = fopen(file, "wb");
+	if (out == NULL) return false;
+	int32_t dims[3] = {NNUE_INPUTS, NNUE_HIDDEN, NNUE_L2};
+	bool ok = fwrite(NNUE_MAGIC, 8, 1, out) == 1 && fwrite(dims, sizeof(dims), 1, out) == 1 &&
+		fwrite(w1, sizeof(w1), 1, out) == 1 && fwrite(b1, sizeof(b1), 1, out) == 1 &&
+		fwrite(w2, sizeof(w2), 1, out) == 1 && fwrite(b2, sizeof(b2), 1, out) == 1 &&
+		fwrite(w3, sizeof(w3), 1, out) == 1 && fwrite(&b3, sizeof(b3), 1, out) == 1 &&
+		fwrite(&outputShift, sizeof(outputShift), 1, out) == 1;
+	return (fclose(out) == 0) && ok;
+}
+
+/*
+ * Fills the network with small random weights. Only meant for benchmarks
+ * and tests when no trained network is at hand.
+ */
+void Network::randomize(uint64_t seed) {
+	uint64_t s = seed | 1;
+	for (int i = 0; i < NNUE_INPUTS; i++)
+		for (int h = 0; h < NNUE_HIDDEN; h++) {
+			s ^= s << 13; s ^= s >> 7; s ^= s << 17;
+			w1[i][h] = (int16_t) (s % 17) - 8;
+		}
+	for (int h = 0; h < NNUE_HIDDEN; h++) b1[h] = 32;
+	for (int j = 0; j < NNUE_L2; j++) {
+		for (int h = 0; h < NNUE_HIDDEN; h++) {
+			s ^= s << 13; s ^= s >> 7; s ^= s << 17;
+			w2[j][h] = (int8_t) ((int) (s % 33) - 16);
+		}
+		b2[j] = 0;
+		w3[j] = (int16_t) ((j % 2) ? 16 : -16);
+	}
+	b3 = 0;
+	outputShift = 4;
+}
+
+/*
+ * A 64 bit FNV-1a hash of every weight, in file order, which tells apart
+ * caches of scores from different networks.
+ */
+static uint64_t hashBytes(uint64_t h, const void *data, size_t size) {
+	const unsigned char *bytes = (const unsigned char *) data;
+	for (size_t i = 0; i < size; i++) {
+		h ^= bytes[i];
+		h *= 0x100000001B3ULL;
+	}
+	return h;
+}
+
+uint64_t Network::hash() const {
+	uint64_t h = 0xCBF29CE484222325ULL;
+	h = hashBytes(h, w1, sizeof(w1));
+	h = hashBytes(h, b1, sizeof(b1));
+	h = hashBytes(h, w2, sizeof(w2));
+	h = hashBytes(h, b2, sizeof(b2));
+	h = hashBytes(h, w3, sizeof(w3));
+	h = hashBytes(h, &b3, sizeof(b3));
+	return hashBytes(h, &outputShift, sizeof(outputShift));
+}
+
+/*
+ * Sums the accumulator from scratch for the given stones.
+ */
+void Network::refresh(Accumulator *acc, uint64_t black, uint64_t white) const {
+	memcpy(acc->v, b1, sizeof(b1));
+	while (black) {
+		add(acc, __builtin_ctzll(black), BLACK);
+		black &= black - 1;
+	}
+	while (white) {
+		add(acc, __builtin_ctzll(white), WHITE);
+		white &= white - 1;
+	}
+}
+
+/*
+ * Updates the accumulator for a stone appearing on a square.
+ */
+void Network::add(Accumulator *acc, int square, Side side) const {
+	const int16_t *column = w1[inputOf(square, side)];
+#ifdef __AVX2__
+	for (int h = 0; h < NNUE_HIDDEN; h += 16) {
+		__m256i a = _mm256_loadu_si256((const __m256i *) (acc->v + h));
+		__m256i w = _mm256_loadu_si256((const __m256i *) (column + h));
+		_mm256_storeu_si256((__m256i *) (acc->v + h), _mm256_add_epi16(a, w));
+	}
+#else
+	for (int h = 0; h < NNUE_HIDDEN; h++) acc->v[h] += column[h];
+#endif
+}
+
+/*
+ * Updates the accumulator for a stone leaving a square.
+ */
+void Network::remove(Accumulator *acc, int square, Side side) const {
+	const int16_t *column = w1[inputOf(square, side)];
+#ifdef __AVX2__
+	for (int h = 0; h < NNUE_HIDDEN; h += 16) {
+		__m256i a = _mm256_loadu_si256((const __m256i *) (acc->v + h));
+		__m256i w = _mm256_loadu_si256((const __m256i *) (column + h));
+		_mm256_storeu_si256((__m256i *) (acc->v + h), _mm256_sub_epi16(a, w));
+	}
+#else
+	for (int h = 0; h < NNUE_HIDDEN; h++) acc->v[h] -= column[h];
+#endif
+}
+
+static inline int clip127(int x) {
+	return x < 0 ? 0 : (x > 127 ? 127 : x);
+}
+
+/*
+ * Runs the rest of the network on an accumulator and returns the score for
+ * the given side. The network scores positions for black.
+ */
+int Network::evaluate(const Accumulator *acc, Side side) const {
+	alignas(32) uint8_t hidden[NNUE_HIDDEN];
+	int32_t out = b3;
+#ifdef __AVX2__
+	// Clip the accumulator to 0..127 bytes; packus works within 128 bit
+	// lanes, so put the quarters back in order afterwards
+	const __m256i top = _mm256_set1_epi8(127);
+	for (int h = 0; h < NNUE_HIDDEN; h += 32) {
+		__m256i lo = _mm256_loadu_si256((const __m256i *) (acc->v + h));
+		__m256i hi = _mm256_loadu_si256((const __m256i *) (acc->v + h + 16));
+		__m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(lo, hi), 0xD8);
+		_mm256_store_si256((__m256i *) (hidden + h), _mm256_min_epu8(packed, top));
+	}
+	const __m256i ones = _mm256_set1_epi16(1);
+	for (int j = 0; j < NNUE_L2; j++) {
+		// Byte products are summed in pairs to int16 (at most 2*127*128, so
+		// never saturating) and then to int32
+		__m256i sum = _mm256_setzero_si256();
+		for (int h = 0; h < NNUE_HIDDEN; h += 32) {
+			__m256i x = _mm256_load_si256((const __m256i *) (hidden + h));
+			__m256i w = _mm256_loadu_si256((const __m256i *) (w2[j] + h));
+			sum = _mm256_add_epi32(sum, _mm256_madd_epi16(_mm256_maddubs_epi16(x, w), ones));
+		}
+		__m128i s = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+		s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4E));
+		s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xB1));
+		out += w3[j] * clip127((b2[j] + _mm_cvtsi128_si32(s)) >> 6);
+	}
+#else
+	for (int h = 0; h < NNUE_HIDDEN; h++) hidden[h] = clip127(acc->v[h]);
+	for (int j = 0; j < NNUE_L2; j++) {
+		int32_t sum = b2[j];
+		for (int h = 0; h < NNUE_HIDDEN; h++) sum += hidden[h] * w2[j][h];
+		out += w3[j] * clip127(sum >> 6);
+	}
+#endif
+	int score = out >> outputShift;
+	return (side == BLACK) ? score : -score;
+}
@@ -0,0 +1,51 @@
+#ifndef __NNUE_H__
+#define __NNUE_H__
+
+#include <cstdint>
+#include "common.h"
+
+// One input for every (square, colour) pair
+#define NNUE_INPUTS 128
+#define NNUE_HIDDEN 128
+#define NNUE_L2 32
+
+/**
+ * The first layer's output for one position: the bias plus the weight
+ * column of every stone on the board. It is kept up to date as stones are
+ * placed and turned over, instead of being summed from scratch.
+ */
+struct Accumulator
+{
+	int16_t v[NNUE_HIDDEN];
+};
+
+/**
+ * A small quantised network that scores positions. The first layer is
+ * int16 and only ever updated incrementally; its outputs are clipped to
+ * 0..127 and fed through an int8 layer of NNUE_L2 clipped units and an
+ * int16 output unit. Weights are read only once loaded, so one network can
+ * be shared by any number of boards and threads.
+ */
+class Network {
+	int16_t w1[NNUE_INPUTS][NNUE_HIDDEN];
+	int16_t b1[NNUE_HIDDEN];
+	int8_t w2[NNUE_L2][NNUE_HIDDEN];
+	int32_t b2[NNUE_L2];
+	int16_t w3[NNUE_L2];
+	int32_t b3;
+	// Right shift turning the output unit into evaluation points
+	int32_t outputShift;
+
+public:
+	bool load(const char *file);
+	bool save(const char *file) const;
+	void randomize(uint64_t seed);
+	uint64_t hash() const;
+
+	void refresh(Accumulator *acc, uint64_t black, uint64_t white) const;
+	void add(Accumulator *acc, int square, Side side) const;
+	void remove(Accumulator *acc, int square, Side side) const;
+	int evaluate(const Accumulator *acc, Side side) const;
+};
+
+#endif
@@ -1,4 +1,10 @@
 #include "player.h"
+#include "search.h"
+#include "bitboard.h"
+
+// The search the engine plays with: any of the searches of search.h, or a
+// new one put together from its parts
+typedef NegascoutSearch EngineSearch;
 
 /*
  * Constructor for the player; initialize everything here. The side your AI is
@@ -13,11 +19,17 @@ Player::Player(Side side) {
 	// Save what side we are and what side the opponent is on
 	me = side;
 	opp = (side == WHITE) ? BLACK : WHITE;
-	// Change the depth of search at different points depending on whether
-	// playing white or black
-	if (me == BLACK) depth = 44;
-	else depth = 43;
-	haveTime = true;
+	// The move handed back from doMove is kept here, so a search never has
+	// to allocate one
+	chosenMove = new Move(-1, -1);
+	// Games are only recorded if a log is given
+	log = NULL;
+	record = NULL;
+	// Negascout unless asked to use Monte Carlo tree search
+	mcts = NULL;
+	endgame = NULL;
+	lastDepth = 0;
+	lastScore = 0;
 }
 
 /*
@@ -25,12 +37,143 @@ Player::Player(Side side) {
  */
 Player::~Player() {
 	delete board;
+	delete chosenMove;
+	delete record;
+	delete mcts;
+	delete endgame;
 }
 
 void Player::setBoard(Board *newBoard) {
 	board = newBoard;
 }
 
+/*
+ * Lets the searches look up and save results in a persistent cache shared
+ * with earlier games.
+ */
+void Player::setCache(SolveCache *cache) {
+	board->cache = cache;
+}
+
+/*
+ * Lets the evaluation look up and save scores in the given cache, which
+ * the players of other threads may share.
+ */
+void Player::setEvalCache(EvalCache *evalCache) {
+	board->evalCache = evalCache;
+}
+
+/*
+ * Makes the evaluation use the given (usually tuned) weights.
+ */
+void Player::setWeights(const EvalWeights *weights) {
+	board->weights = weights;
+}
+
+/*
+ * Makes the evaluation use a neural network instead of the weighted
+ * features.
+ */
+void Player::setNetwork(const Network *network) {
+	board->setNetwork(network);
+}
+
+/*
+ * Changes which selective search techniques negascout uses, and how
+ * aggressively.
+ */
+void Player::setSearchParams(const SearchParams &params) {
+	board->params = params;
+}
+
+/*
+ * Starts keeping a record of this game, which is added to the log when
+ * gameOver is called.
+ */
+void Player::setLog(GameLog *log) {
+	this->log = log;
+	record = new GameRecord();
+	record->start(me);
+}
+
+/*
+ * Chooses moves with Monte Carlo tree search, running simulations on the
+ * given number of threads, instead of negascout. A deterministic search
+ * runs the threads in turn from the given seed, so a playout limit gives
+ * the same moves every time.
+ */
+void Player::useMcts(int threads, int treeNodes, bool deterministic, uint64_t seed) {
+	// By default a million nodes of tree, about 56MB
+	delete mcts;
+	mcts = new Mcts(treeNodes, threads);
+	mcts->deterministic = deterministic;
+	mcts->seed = seed;
+}
+
+/*
+ * Solves the last empty squares exactly with the parallel endgame solver on
+ * the given number of threads, instead of with negascout on one, when
+ * playing under the clock. The solver, its table and its threads are made
+ * now, so that no move has to wait for them; only doMove uses them, so
+ * players searching by other means should not ask.
+ */
+void Player::useEndgameThreads(int threads) {
+	delete endgame;
+	// Results stay exact from move to move, so the table is kept
+	endgame = (threads > 1) ? new EndgameSolver(threads, 20) : NULL;
+}
+
+/*
+ * Adds the move we chose (NULL for a pass) and what the search did to find
+ * it to the game record.
+ */
+void Player::noteMove(Move *move, int searchDepth, int score) {
+	if (record == NULL) return;
+	record->addMove(move == NULL ? PASS_MOVE : move->x + move->y*8);
+	long ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::steady_clock::now() - moveStart).count();
+	record->addStats(ms, searchDepth, score, board->nodes - nodesBefore);
+}
+
+/*
+ * Called once the game has finished. Hands the game record to the log,
+ * with the discs on the last board we saw if neither side could move
+ * there. Otherwise we did not see the end, and the result is unknown
+ * rather than wrong.
+ */
+void Player::gameOver() {
+	if (record == NULL) return;
+	uint64_t black = board->getBlack(), white = board->getWhite();
+	if (moveMask(black, white) == 0 && moveMask(white, black) == 0) {
+		record->blackDiscs = board->countBlack();
+		record->whiteDiscs = board->countWhite();
+	}
+	else {
+		record->blackDiscs = UNKNOWN_DISCS;
+		record->whiteDiscs = UNKNOWN_DISCS;
+	}
+	log->append(*record);
+}
+
+/*
+ * Starts our turn: notes the opponent's move (or pass) in the game record
+ * and does it on the board.
+ */
+void Player::startMove(Move *opponentsMove) {
+	moveStart = std::chrono::steady_clock::now();
+	nodesBefore = board->nodes;
+	// Black's very first call has no move before it
+	if (record != NULL) {
+		if (opponentsMove != NULL) record->addMove(opponentsMove->x + opponentsMove->y*8);
+		else if (!(me == BLACK && record->numMoves == 0)) record->addMove(PASS_MOVE);
+	}
+
+	board->doMove(opponentsMove, opp);
+	if (opponentsMove != NULL) {
+		board->moves.push(-5);
+	}
+}
+
 /*
  * Compute the next move given the opponent's last move. Your AI is
  * expected to keep track of the board on its own. If this is the first move,
@@ -41,15 +184,12 @@ void Player::setBoard(Board *newBoard) {
  * be disqualified! An msLeft value of -1 indicates no time limit.
  *
  * The move returned must be legal; if there are no valid moves for your side,
- * return NULL.
+ * return NULL. The returned move belongs to the player and is only valid
+ * until the next call, so the caller must not delete it.
  */
 Move *Player::doMove(Move *opponentsMove, int msLeft) {
-	board->doMove(opponentsMove, opp);
-
 	// First do the opponent's move
-	if (opponentsMove != NULL) {
-		Board::moves->push(-5);
-	}
+	startMove(opponentsMove);
 	
 	// Calculate some random valid move and return that move
      /* The random way
@@ -66,133 +206,137 @@ Move *Player::doMove(Move *opponentsMove, int msLeft) {
     // and minimax, merely change testingMinimax to true in the constructor
     // and call board->getBest(5, 1, true, true).
 	if (testingMinimax) {
-		board->getBest(2, 1, true, true);
+		int score = board->getBest(2, 1, true, true);
 
-		Move *goodMove = new Move(board->moveToDo->getX(), board->moveToDo->getY());
+		Move *goodMove = chosenMove;
+		goodMove->setX(board->moveToDo->getX());
+		goodMove->setY(board->moveToDo->getY());
 		// After we got a move, we will reset the next move to be -1 for now
 		board->moveToDo->setX(-1);
 		board->moveToDo->setY(-1);
-		if (goodMove->getX() == -1) return NULL;
+		if (goodMove->getX() == -1) {
+			noteMove(NULL, 2, score);
+			return NULL;
+		}
 		// We will also undo all moves done after the permanent ones before
 		// pushing the new move on
-		while (!Board::moves->empty() && Board::moves->top() != -5) {
+		while (!board->moves.empty() && board->moves.top() != -5) {
 			board->undoMove();
 		}
 
 		board->doMove(goodMove, me);
 		// Push a marker move -5 to signify a permanent move has been done
-		Board::moves->push(-5);
+		board->moves.push(-5);
 
+		noteMove(goodMove, 2, score);
+		return goodMove;
+	}
+	// Monte Carlo tree search, which needs no evaluation at all
+	else if (mcts != NULL) {
+		uint64_t mine = (me == BLACK) ? board->getBlack() : board->getWhite();
+		uint64_t theirs = (me == BLACK) ? board->getWhite() : board->getBlack();
+		// Without a clock use a fixed number of playouts, otherwise share the
+		// time left out over the moves we still have to make
+		long playouts = 20000;
+		int ms = 0;
+		if (msLeft > 0) {
+			int empty = 64 - board->countBlack() - board->countWhite();
+			playouts = 1L << 40;
+			ms = msLeft / (empty/2 + 2);
+		}
+		int square = mcts->search(mine, theirs, playouts, ms);
+		if (square < 0) {
+			noteMove(NULL, 0, 0);
+			return NULL;
+		}
+
+		Move *goodMove = chosenMove;
+		goodMove->setX(square%8);
+		goodMove->setY(square/8);
+		while (!board->moves.empty() && board->moves.top() != -5) {
+			board->undoMove();
+		}
+		board->doMove(goodMove, me);
+		// Push a marker move -5 to signify a permanent move has been done
+		board->moves.push(-5);
+
+		noteMove(goodMove, 0, 0);
 		return goodMove;
 	}
 	// Otherwise, this will be implemented better later to include more
 	// advanced heuristic...
 	else {
-		// Call negascout, which is an improvement over plain alpha beta pruning
+		// Call the engine's search, negascout unless EngineSearch says
+		// otherwise, which is an improvement over plain alpha beta pruning
 		// to take less time
-		// Does an initial search of depth 5
-		board->negascout(7, -100000000, 100000000, 1, true, true, 0);
-		 // Save the search result for the initial depth
-		 Move *goodMove = new Move(board->moveToDo->getX(), board->moveToDo->getY());
-		 // If we have 3 minutes left and haven't had to exit a recursive
-		 // call before, search at greater depth
-		if (msLeft > 180000 && haveTime) {
-			int sc = 0;
-			// If more than 43-44 squares on the board have been taken
-			// can search at great depth
-			if (board->countBlack() + board->countWhite() > depth) {
-				sc = board->negascout(20, -100000000, 100000000, 1, true, true, 0.);
-			}
-			// If more than 32 squares have been taken, can search at medium depth
-			else if (board->countBlack() + board->countWhite() > 32) {
-				sc = board->negascout(12, -100000000, 100000000, 1, true, true, 0.);
-			}
-			// Otherwise, just search at depth 8
-			else {
-				sc = board->negascout(8, -100000000, 100000000, 1, true, true, 0.);
-			}
-			// Will return +/- 65 as score if ran out of time, so if that
-			// is the score, don't use result of newer calculation
-			if (abs(sc) != 65) {
-				goodMove->setX(board->moveToDo->getX());
-				goodMove->setY(board->moveToDo->getY());
-			}
-			// If we did run out of time, then don't search big depth again
-			else if (abs(sc) == 65 && board->moveToDo->getX() == -3) {
-				haveTime = false;
-			}
+		int searchDepth = 0;
+		int searchScore = 0;
+		Move *goodMove = chosenMove;
+		// Without a clock, a single search of depth 7
+		if (msLeft < 0) {
+			searchDepth = 7;
+			searchScore = board->search<EngineSearch>(7, -100000000, 100000000, 1, true, true, 0);
+			board->printPrincipalVariation(searchDepth, searchScore);
+			goodMove->setX(board->moveToDo->getX());
+			goodMove->setY(board->moveToDo->getY());
 		}
-		
-		// All the same type of calls, but using alpha beta instead of negascout
-		/*board->alphabeta(7, -100000000, 100000000, 1, true, 0);
-		 Move *goodMove = new Move(board->moveToDo->getX(), board->moveToDo->getY());
-		if (msLeft > 180000 && haveTime) { // Change this to either 3/4 minutes
-			int sc = 0;
-			if (board->countBlack() + board->countWhite() > depth) {
-				sc = board->alphabeta(17, -100000000, 100000000, 1, true, 0.);
-			}
-			else if (board->countBlack() + board->countWhite() > 32) {
-				sc = board->alphabeta(12, -100000000, 100000000, 1, true, 0.);
+		// Otherwise deepen for as long as the time manager allows
+		else {
+			int empty = 64 - board->countBlack() - board->countWhite();
+			timeManager.startMove(msLeft, empty);
+			SearchLimits limits;
+			limits.movetime = timeManager.hardLimit();
+			// With the parallel solver a quick search first, so that a solve
+			// cut off by the clock still leaves a move
+			bool solve = endgame != NULL && empty <= SOLVE_EMPTIES;
+			if (solve) limits.depth = 7;
+			setStop(false);
+			int square = search(limits, solve ? NULL : checkTime, this);
+			setStop(false);
+			goodMove->setX(square < 0 ? -1 : square%8);
+			goodMove->setY(square < 0 ? -1 : square/8);
+			searchDepth = lastDepth;
+			searchScore = lastScore;
+			if (solve && square >= 0) {
+				uint64_t mine = (me == BLACK) ? board->getBlack() : board->getWhite();
+				uint64_t theirs = (me == BLACK) ? board->getWhite() : board->getBlack();
+				endgame->hasDeadline = true;
+				endgame->deadline = moveStart + std::chrono::milliseconds(timeManager.hardLimit());
+				int sc;
+				square = endgame->bestMove(mine, theirs, &sc);
+				if (square >= 0) {
+					goodMove->setX(square%8);
+					goodMove->setY(square/8);
+					searchDepth = empty;
+					searchScore = sc;
+				}
 			}
-			else {
-				sc = board->alphabeta(8, -100000000, 100000000, 1, true, 0.);
-			}
-			
-			if (abs(sc) != 65) {
-				goodMove->setX(board->moveToDo->getX());
-				goodMove->setY(board->moveToDo->getY());
-			}
-			else if (abs(sc) == 65 && board->moveToDo->getX() == -3) {
-				std::cerr << "Run out of time" << std::endl;
-				haveTime = false;
-			}
-		}*/
-		
+		}
 		
 		// After we got a move, we will reset the next move to be -1 for now
 		board->moveToDo->setX(-1);
 		board->moveToDo->setY(-1);
 
-		if (goodMove->getX() < 0 || goodMove->getY() < 0) return NULL;
+		if (goodMove->getX() < 0 || goodMove->getY() < 0) {
+			noteMove(NULL, searchDepth, searchScore);
+			return NULL;
+		}
 
 		
 		// We will also undo all moves done after the permanent ones before
 		// pushing the new move on
-		while (!Board::moves->empty() && Board::moves->top() != -5) {
+		while (!board->moves.empty() && board->moves.top() != -5) {
 			board->undoMove();
 		}
 
 		board->doMove(goodMove, me);
 		// Push a marker move -5 to signify a permanent move has been done
-		Board::moves->push(-5);
+		board->moves.push(-5);
 
+		noteMove(goodMove, searchDepth, searchScore);
 		return goodMove;
 	}
 	
-	// If not testing minimax, can do search with depth of 5 using naive
-	// heuristic for minimax
-	/*else {
-		board->getBest(5, 1, true, true);
-
-		Move *goodMove = new Move(board->moveToDo->getX(), board->moveToDo->getY());
-		// After we got a move, we will reset the next move to be -1 for now
-		board->moveToDo->setX(-1);
-		board->moveToDo->setY(-1);
-		if (goodMove->getX() == -1) return NULL;
-		// We will also undo all moves done after the permanent ones before
-		// pushing the new move on
-		while (!Board::moves->empty() && Board::moves->top() != -5) {
-			board->undoMove();
-		}
-
-		board->doMove(goodMove, me);
-		// Push a marker move -5 to signify a permanent move has been done
-		Board::moves->push(-5);
-
-		return goodMove;
-	}*/
-	
-	
 	// The Basic Heuristic, that doesn't look ahead into the future
 	// but still chooses squares based on the position's score
    /* int bestCoord = board->bestMove(me);
@@ -202,3 +346,265 @@ Move *Player::doMove(Move *opponentsMove, int msLeft) {
     return best; */
     
 }
+
+/*
+ * Hears of every depth the search of doMove finishes, prints it, and stops
+ * the search once the time manager says the move is worth no more time.
+ */
+void Player::checkTime(void *context, const SearchInfo &info) {
+	Player *player = (Player *) context;
+	if (!info.complete) return;
+	player->board->printPrincipalVariation(info.depth, info.score);
+	manageTime(context, info);
+}
+
+/*
+ * Like checkTime without the printing, for playClock.
+ */
+void Player::manageTime(void *context, const SearchInfo &info) {
+	Player *player = (Player *) context;
+	if (!info.complete) return;
+	if (player->timeManager.iterationDone(info.depth, info.pv[0], info.score, info.ms)) player->setStop(true);
+}
+
+/*
+ * Sets up the given position, with our side to move, in place of the game
+ * so far.
+ */
+void Player::setPosition(uint64_t black, uint64_t white) {
+	board->setPosition(black, white);
+	board->moves.size = 0;
+	board->moves.push(-5);
+	board->moveToDo->setX(-1);
+	board->moveToDo->setY(-1);
+}
+
+/*
+ * Asks the running search to finish as soon as it can, or clears the
+ * request before the next one. Safe to call from another thread.
+ */
+void Player::setStop(bool stop) {
+	board->stop = stop;
+	if (mcts != NULL) mcts->stop = stop;
+}
+
+/**
+ * What the board's progress calls need to report on a search.
+ */
+struct Progress
+{
+	Board *board;
+	SearchReport report;
+	void *context;
+	std::chrono::steady_clock::time_point start;
+	long startNodes;
+	long startProbes, startHits;
+	int depth;
+};
+
+static long millisSince(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::steady_clock::now() - start).count();
+}
+
+/*
+ * The evaluation cache hit rate since the search started, per thousand.
+ */
+static int evalHitRate(const Progress *progress) {
+	Board *board = progress->board;
+	if (board->evalCache == NULL) return -1;
+	long probes = board->evalProbes - progress->startProbes;
+	return (probes > 0) ? (int) ((board->evalHits - progress->startHits) * 1000 / probes) : 0;
+}
+
+static void reportProgress(void *context) {
+	Progress *progress = (Progress *) context;
+	SearchInfo info;
+	info.complete = false;
+	info.line = 1;
+	info.depth = progress->depth;
+	info.score = 0;
+	info.nodes = progress->board->nodes - progress->startNodes;
+	info.ms = millisSince(progress->start);
+	info.evalHits = evalHitRate(progress);
+	info.pvLength = 0;
+	progress->report(progress->context, info);
+}
+
+/*
+ * Searches the position for our side within the given limits without
+ * playing the move, deepening one ply at a time, and returns the square of
+ * the best move found (-1 to pass). report, if not NULL, hears about every
+ * finished depth and, about once a second, how the current one is going.
+ * A search cut off by its limits or setStop answers with the best move of
+ * the last depth it finished.
+ */
+int Player::search(const SearchLimits &limits, SearchReport report, void *context) {
+	SearchInfo line;
+	if (searchLines(limits, 1, &line, report, context) == 0) return -1;
+	return line.pv[0];
+}
+
+/*
+ * Like search, but finds the best count moves rather than only the best,
+ * each with its exact score and line, in one search per depth: the root
+ * only closes its window once it has that many lines, and from then on
+ * a move has to beat the worst of them. lines gets them best first, and
+ * report hears about each line of a finished depth. Returns how many
+ * lines there are, 0 if we have to pass. Monte Carlo search only finds
+ * the best move.
+ */
+int Player::searchLines(const SearchLimits &limits, int count, SearchInfo *lines, SearchReport report, void *context) {
+	Progress progress;
+	progress.board = board;
+	progress.report = report;
+	progress.context = context;
+	progress.start = std::chrono::steady_clock::now();
+	progress.startNodes = board->nodes;
+	progress.startProbes = board->evalProbes;
+	progress.startHits = board->evalHits;
+	progress.depth = 0;
+	lastDepth = 0;
+	lastScore = 0;
+
+	int moveList[64];
+	int numMoves = board->getMoves(me, moveList);
+	if (numMoves == 0) return 0;
+	if (count > numMoves) count = numMoves;
+	if (count < 1) count = 1;
+	if (mcts != NULL) count = 1;
+	// Should not even the first depth finish, any legal moves will do
+	for (int i = 0; i < count; i++) {
+		lines[i].complete = false;
+		lines[i].line = i + 1;
+		lines[i].depth = 0;
+		lines[i].score = 0;
+		lines[i].nodes = 0;
+		lines[i].ms = 0;
+		lines[i].evalHits = -1;
+		lines[i].pvLength = 1;
+		lines[i].pv[0] = moveList[i];
+	}
+
+	if (mcts != NULL) {
+		uint64_t mine = (me == BLACK) ? board->getBlack() : board->getWhite();
+		uint64_t theirs = (me == BLACK) ? board->getWhite() : board->getBlack();
+		long playouts = (limits.nodes > 0) ? limits.nodes : 1L << 40;
+		int square = mcts->search(mine, theirs, playouts, limits.movetime);
+		if (square >= 0) lines[0].pv[0] = square;
+		lines[0].complete = true;
+		lines[0].nodes = mcts->treeSize();
+		lines[0].ms = millisSince(progress.start);
+		if (report != NULL) report(context, lines[0]);
+		return 1;
+	}
+
+	board->nodeLimit = (limits.nodes > 0) ? board->nodes + limits.nodes : 0;
+	board->hasDeadline = limits.movetime > 0;
+	board->deadline = progress.start + std::chrono::milliseconds(limits.movetime);
+	board->progress = (report != NULL) ? reportProgress : NULL;
+	board->progressContext = &progress;
+	board->nextProgress = progress.start + std::chrono::milliseconds(board->progressInterval);
+
+	int maxDepth = (limits.depth > 0 && limits.depth < MAX_PLY) ? limits.depth : MAX_PLY - 1;
+	int empty = 64 - board->countBlack() - board->countWhite();
+	board->multiPv = count;
+	for (int d = 1; d <= maxDepth; d++) {
+		progress.depth = d;
+		board->moveToDo->setX(-1);
+		board->moveToDo->setY(-1);
+		// The board checks every limit, so the search never reads the clock
+		// itself: without a movetime the same position and limits always
+		// give the same move and node count
+		int score = board->search<UntimedSearch<EngineSearch> >(d, -100000000, 100000000, 1, true, true, 0);
+		// A search that was cut off does not count
+		if (board->moveToDo->getX() == -3) break;
+		long nodes = board->nodes - progress.startNodes;
+		long ms = millisSince(progress.start);
+		for (int i = 0; i < count; i++) {
+			SearchInfo &info = lines[i];
+			info.complete = true;
+			info.depth = d;
+			info.nodes = nodes;
+			info.ms = ms;
+			info.evalHits = evalHitRate(&progress);
+			if (count > 1) {
+				int length = board->rootLineOf(i, info.pv, &info.score);
+				if (length > 0) info.pvLength = length;
+				continue;
+			}
+			info.score = score;
+			info.pvLength = board->principalVariation(info.pv);
+			if (info.pvLength == 0 && board->moveToDo->getX() >= 0) {
+				info.pv[0] = board->moveToDo->x + board->moveToDo->y*8;
+				info.pvLength = 1;
+			}
+			// Keep the move of the depth before if not even that is known
+			if (info.pvLength == 0) info.pvLength = 1;
+		}
+		lastDepth = d;
+		lastScore = lines[0].score;
+		if (report != NULL) {
+			for (int i = 0; i < count; i++) report(context, lines[i]);
+		}
+		// Any deeper only searches the same finished games again
+		if (d >= empty) break;
+	}
+
+	// Leave the board as we found it, without limits
+	while (!board->moves.empty() && board->moves.top() != -5) {
+		board->undoMove();
+	}
+	board->moveToDo->setX(-1);
+	board->moveToDo->setY(-1);
+	board->nodeLimit = 0;
+	board->hasDeadline = false;
+	board->progress = NULL;
+	board->multiPv = 1;
+	return count;
+}
+
+/*
+ * Like doMove, but chooses the move by searching within the given limits
+ * rather than by the clock.
+ */
+Move *Player::playMove(Move *opponentsMove, const SearchLimits &limits) {
+	startMove(opponentsMove);
+	return playSearch(limits, NULL);
+}
+
+/*
+ * Like doMove with msLeft on our clock, sharing the time out with the time
+ * manager the same way, but quietly and with negascout alone (or Monte
+ * Carlo search), for hosting many games at once.
+ */
+Move *Player::playClock(Move *opponentsMove, long msLeft) {
+	startMove(opponentsMove);
+	timeManager.startMove(msLeft, 64 - board->countBlack() - board->countWhite());
+	SearchLimits limits;
+	// Monte Carlo search has no depths to stop between, so it gets the
+	// soft budget outright
+	limits.movetime = (mcts != NULL) ? timeManager.softLimit() : timeManager.hardLimit();
+	return playSearch(limits, manageTime);
+}
+
+/*
+ * Searches for our move once startMove has set the board up, and plays it.
+ */
+Move *Player::playSearch(const SearchLimits &limits, SearchReport report) {
+	// The last search may have ended by running out of time
+	setStop(false);
+	int square = search(limits, report, this);
+	if (square < 0) {
+		noteMove(NULL, lastDepth, lastScore);
+		return NULL;
+	}
+	Move *goodMove = chosenMove;
+	goodMove->setX(square%8);
+	goodMove->setY(square/8);
+	board->doMove(goodMove, me);
+	// Push a marker move -5 to signify a permanent move has been done
+	board->moves.push(-5);
+	noteMove(goodMove, lastDepth, lastScore);
+	return goodMove;
+}
@@ -5,19 +5,92 @@
 #include "common.h"
 #include <limits>
 #include "board.h"
+#include "gamelog.h"
+#include "mcts.h"
+#include "endgame.h"
+#include "timeman.h"
+#include <chrono>
 using namespace std;
 
+/**
+ * What a search may use. Zero means no limit on that count; with no limit
+ * at all the search goes on until it is stopped or has solved the game.
+ */
+struct SearchLimits
+{
+	int depth;
+	long nodes;
+	long movetime;
+	SearchLimits() {
+		depth = 0;
+		nodes = 0;
+		movetime = 0;
+	}
+};
+
+/**
+ * Progress of a search: after every finished depth (complete is set) and
+ * every so often in between.
+ */
+struct SearchInfo
+{
+	bool complete;
+	// Which of the best lines this is, from 1
+	int line;
+	int depth;
+	int score;
+	long nodes;
+	long ms;
+	// Per thousand evaluations, how many the evaluation cache had, or -1
+	// without one
+	int evalHits;
+	int pvLength;
+	int pv[MAX_PLY];
+};
+
+typedef void (*SearchReport)(void *context, const SearchInfo &info);
+
 class Player {
 	Side me;
 	Side opp;
 	Board *board;
+	Move *chosenMove;
+	GameLog *log;
+	GameRecord *record;
+	std::chrono::steady_clock::time_point moveStart;
+	long nodesBefore;
+	Mcts *mcts;
+	// Solves the last empty squares on several threads, if asked to
+	EndgameSolver *endgame;
+	TimeManager timeManager;
+	// Depth and score of the last depth search finished
+	int lastDepth;
+	int lastScore;
+	void startMove(Move *opponentsMove);
+	void noteMove(Move *move, int searchDepth, int score);
+	static void checkTime(void *context, const SearchInfo &info);
+	static void manageTime(void *context, const SearchInfo &info);
+	Move *playSearch(const SearchLimits &limits, SearchReport report);
 public:
     Player(Side side);
     ~Player();
-    bool haveTime;
-	int depth;
     void setBoard(Board *newBoard);
+    void setCache(SolveCache *cache);
+    void setEvalCache(EvalCache *evalCache);
+    void setWeights(const EvalWeights *weights);
+    void setLog(GameLog *log);
+    void useMcts(int threads, int treeNodes = 1 << 20, bool deterministic = false, uint64_t seed = 1);
+    void useEndgameThreads(int threads);
+    void setNetwork(const Network *network);
+    void setSearchParams(const SearchParams &params);
+    void gameOver();
     Move *doMove(Move *opponentsMove, int msLeft);
+    void setPosition(uint64_t black, uint64_t white);
+    int search(const SearchLimits &limits, SearchReport report, void *context);
+    int searchLines(const SearchLimits &limits, int count, SearchInfo *lines, SearchReport report, void *context);
+    Move *playMove(Move *opponentsMove, const SearchLimits &limits);
+    Move *playClock(Move *opponentsMove, long msLeft);
+    void setStop(bool stop);
 
     // Flag to tell if the player is running within the test_minimax context
     bool testingMinimax;
@@ -0,0 +1,49 @@
+#include "playout.h"
+
+#define CORNER_SQUARES 0x8100000000000081ULL
+
+/*
+ * Plays the position out to the end of the game with random legal moves and
+ * returns the final disc difference for the side to move. With
+ * preferCorners a corner is always taken when one is available, which
+ * makes the games a little more like real ones for almost no cost.
+ */
+int playout(uint64_t me, uint64_t opp, Xorshift &rng, bool preferCorners) {
+	bool swapped = false;
+	int passes = 0;
+	while (passes < 2) {
+		uint64_t moves = moveMask(me, opp);
+		if (moves == 0) {
+			passes++;
+		}
+		else {
+			passes = 0;
+			if (preferCorners && (moves & CORNER_SQUARES)) moves &= CORNER_SQUARES;
+			int sq = selectBit(moves, rng.below(popcount(moves)));
+			uint64_t flips = flipMask(sq, me, opp);
+			me |= flips | (1ULL << sq);
+			opp &= ~flips;
+		}
+		// The other side moves next
+		uint64_t t = me;
+		me = opp;
+		opp = t;
+		swapped = !swapped;
+	}
+	int diff = popcount(me) - popcount(opp);
+	return swapped ? -diff : diff;
+}
+
+/*
+ * Average result of a number of random playouts, from 0 (always lost) to 1
+ * (always won), for the side to move. Useful for judging positions the
+ * evaluation is unsure about.
+ */
+double monteCarloScore(uint64_t me, uint64_t opp, int playouts, Xorshift &rng) {
+	double total = 0;
+	for (int i = 0; i < playouts; i++) {
+		int diff = playout(me, opp, rng, false);
+		total += (diff > 0) ? 1 : (diff == 0 ? 0.5 : 0);
+	}
+	return total / playouts;
+}
@@ -0,0 +1,48 @@
+#ifndef __PLAYOUT_H__
+#define __PLAYOUT_H__
+
+#include <cstdint>
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+#include "bitboard.h"
+
+/**
+ * xorshift64* random numbers: a few instructions each, no state beyond one
+ * word, and good enough for picking playout moves.
+ */
+struct Xorshift
+{
+	uint64_t state;
+	Xorshift(uint64_t seed) {
+		state = seed ? seed : 0x9E3779B97F4A7C15ULL;
+	}
+	uint64_t next() {
+		state ^= state >> 12;
+		state ^= state << 25;
+		state ^= state >> 27;
+		return state * 0x2545F4914F6CDD1DULL;
+	}
+	// A number from 0 to n - 1, by scaling rather than a slow modulo
+	int below(int n) {
+		return (int) (((next() >> 32) * (uint64_t) n) >> 32);
+	}
+};
+
+/*
+ * The square of the k-th set bit of mask, counting from 0. With BMI2 this is
+ * one pdep; otherwise the lower bits are cleared one at a time.
+ */
+inline int selectBit(uint64_t mask, int k) {
+#ifdef __BMI2__
+	return __builtin_ctzll(_pdep_u64(1ULL << k, mask));
+#else
+	while (k--) mask &= mask - 1;
+	return __builtin_ctzll(mask);
+#endif
+}
+
+int playout(uint64_t me, uint64_t opp, Xorshift &rng, bool preferCorners = false);
+double monteCarloScore(uint64_t me, uint64_t opp, int playouts, Xorshift &rng);
+
+#endif
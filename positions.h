@@ -0,0 +1,25 @@
+#ifndef __POSITIONS_H__
+#define __POSITIONS_H__
+
+#include <cstdint>
+
+// Score value meaning no search score is known for the position
+#define NO_SCORE -32768
+
+/**
+ * A labelled position as stored in binary position files: the stones of
+ * each colour, the side to move (a Side value) and, from the point of view
+ * of the side to move, the final disc difference of the game it came from
+ * and a deep search or theoretical score if one is known.
+ */
+struct PositionRecord
+{
+	uint64_t black;
+	uint64_t white;
+	int8_t toMove;
+	int8_t result;
+	int16_t score;
+	int32_t unused;
+};
+
+#endif
@@ -0,0 +1,410 @@
+#include <sstream>
+#include <cstdlib>
+#include "protocol.h"
+#include "bitboard.h"
+
+/*
+ * Makes a player for the given side with everything the engine was started
+ * with.
+ */
+Player *newPlayer(Side side, const EngineOptions &options) {
+	Player *player = new Player(side);
+	if (options.mcts) {
+		int threads = (options.threads < 1) ? 1 : options.threads;
+		player->useMcts(threads, (int) ((long) options.hashMB * (1 << 20) / sizeof(MctsNode)),
+			options.deterministic, options.seed);
+	}
+	if (options.weights != NULL) player->setWeights(options.weights);
+	if (options.network != NULL) player->setNetwork(options.network);
+	if (options.cache != NULL) player->setCache(options.cache);
+	if (options.evalCache != NULL) player->setEvalCache(options.evalCache);
+	player->setSearchParams(options.params);
+	return player;
+}
+
+static std::string squareName(int square) {
+	if (square < 0) return "pass";
+	std::string name = "a1";
+	name[0] += square%8;
+	name[1] += square/8;
+	return name;
+}
+
+/*
+ * Reads a square like "d3", returning 64 for a pass and -1 for nonsense.
+ */
+static int parseSquare(const std::string &word) {
+	if (word == "pass" || word == "--") return 64;
+	if (word.size() != 2) return -1;
+	int x = (word[0] | 0x20) - 'a', y = word[1] - '1';
+	if (x < 0 || x > 7 || y < 0 || y > 7) return -1;
+	return x + 8*y;
+}
+
+static std::vector<std::string> split(const std::string &line) {
+	std::vector<std::string> words;
+	std::istringstream in(line);
+	std::string word;
+	while (in >> word) words.push_back(word);
+	return words;
+}
+
+Protocol::Protocol(const EngineOptions &options) {
+	this->options = options;
+	player = NULL;
+	playerSide = BLACK;
+	black = 0x0000000810000000ULL;
+	white = 0x0000001008000000ULL;
+	toMove = BLACK;
+	analyzing = false;
+	searchesRead = 0;
+	stoppedUpTo = 0;
+	searchesRun = 0;
+	unlimited = false;
+	inputClosed = false;
+}
+
+Protocol::~Protocol() {
+	delete player;
+}
+
+/*
+ * Handles the commands, the first of which was already read by the caller,
+ * until quit or the end of the input.
+ */
+void Protocol::run(const std::string &firstLine) {
+	enqueue(firstLine);
+	input = std::thread(&Protocol::readInput, this);
+	while (true) {
+		std::string line;
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			ready.wait(guard, [this] { return !commands.empty(); });
+			line = commands.front();
+			commands.pop_front();
+		}
+		if (!execute(line)) break;
+	}
+	input.join();
+}
+
+/*
+ * The input thread: queues every line, but acts on stop and quit at once.
+ */
+void Protocol::readInput() {
+	std::string line;
+	while (getline(cin, line)) {
+		enqueue(line);
+		std::vector<std::string> words = split(line);
+		if (words.empty()) continue;
+		if (words[0] == "stop") requestStop();
+		if (words[0] == "quit") {
+			requestStop();
+			return;
+		}
+	}
+	// The end of the input counts as quit once the commands before it are
+	// done. Nobody is left to stop a search without limits, so stop that.
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		inputClosed = true;
+		if (unlimited && player != NULL) player->setStop(true);
+		ready.notify_all();
+	}
+	enqueue("quit");
+}
+
+void Protocol::enqueue(const std::string &line) {
+	std::vector<std::string> words = split(line);
+	std::lock_guard<std::mutex> guard(lock);
+	if (!words.empty() && (words[0] == "go" || words[0] == "analyze")) searchesRead++;
+	commands.push_back(line);
+	ready.notify_all();
+}
+
+/*
+ * Stops the running search and any that were asked for before this.
+ */
+void Protocol::requestStop() {
+	std::lock_guard<std::mutex> guard(lock);
+	stoppedUpTo = searchesRead;
+	if (player != NULL) player->setStop(true);
+	ready.notify_all();
+}
+
+/*
+ * Carries out one command, returning false on quit.
+ */
+bool Protocol::execute(const std::string &line) {
+	std::vector<std::string> words = split(line);
+	if (words.empty()) return true;
+	const std::string &command = words[0];
+	if (command == "quit") return false;
+	if (command == "uci") {
+		cout << "id name Eeyore" << endl;
+		cout << "option name threads type spin default 1 min 1 max 256" << endl;
+		cout << "option name hash type spin default 56 min 1 max 65536" << endl;
+		cout << "info string hash sizes the mcts tree only" << endl;
+		cout << "option name search type combo default negascout var negascout var mcts" << endl;
+		cout << "option name lmr type check default true" << endl;
+		cout << "option name futility type spin default " << SearchParams().futilityMargin << " min 0 max 10000" << endl;
+		cout << "option name razor type spin default " << SearchParams().razorMargin << " min 0 max 10000" << endl;
+		cout << "option name multipv type spin default 1 min 1 max 64" << endl;
+		cout << "option name seed type spin default 0 min 0 max 2147483647" << endl;
+		cout << "uciok" << endl;
+	}
+	else if (command == "isready") cout << "readyok" << endl;
+	else if (command == "newgame" || command == "ucinewgame") {
+		black = 0x0000000810000000ULL;
+		white = 0x0000001008000000ULL;
+		toMove = BLACK;
+		resetPlayer();
+	}
+	else if (command == "position") setPosition(words);
+	else if (command == "go") go(words, false);
+	else if (command == "analyze") go(words, true);
+	else if (command == "setoption") setOption(words);
+	// stop was already acted on by the input thread
+	else if (command != "stop") cout << "info string unknown command " << command << endl;
+	return true;
+}
+
+/*
+ * position startpos|<64 squares> <b|w> [moves ...]. The squares run a1 b1
+ * ... h8, with 'X', 'b' or '*' for black, 'O' or 'w' for white and anything
+ * else empty.
+ */
+void Protocol::setPosition(const std::vector<std::string> &words) {
+	uint64_t b = 0x0000000810000000ULL, w = 0x0000001008000000ULL;
+	Side side = BLACK;
+	size_t i = 2;
+	if (words.size() >= 2 && words[1] != "startpos") {
+		if (words.size() < 3 || words[1].size() != 64) {
+			cout << "info string bad position" << endl;
+			return;
+		}
+		b = w = 0;
+		for (int sq = 0; sq < 64; sq++) {
+			char c = words[1][sq];
+			if (c == 'X' || c == 'x' || c == 'b' || c == '*') b |= 1ULL << sq;
+			else if (c == 'O' || c == 'o' || c == 'w') w |= 1ULL << sq;
+		}
+		side = (words[2][0] == 'w' || words[2][0] == 'W' || words[2][0] == 'O') ? WHITE : BLACK;
+		i = 3;
+	}
+	if (i < words.size() && words[i] == "moves") {
+		for (i++; i < words.size(); i++) {
+			uint64_t &me = (side == BLACK) ? b : w;
+			uint64_t &opp = (side == BLACK) ? w : b;
+			uint64_t legal = moveMask(me, opp);
+			int square = parseSquare(words[i]);
+			if (square == 64 ? legal != 0 : (square < 0 || !((legal >> square) & 1))) {
+				cout << "info string illegal move " << words[i] << endl;
+				return;
+			}
+			if (square < 64) {
+				uint64_t flips = flipMask(square, me, opp);
+				me |= flips | (1ULL << square);
+				opp &= ~flips;
+			}
+			side = (side == BLACK) ? WHITE : BLACK;
+		}
+	}
+	black = b;
+	white = w;
+	toMove = side;
+}
+
+/*
+ * go [movetime ms] [depth d] [nodes n] [infinite], or analyze. Without a
+ * limit the search only answers once it is stopped.
+ */
+void Protocol::go(const std::vector<std::string> &words, bool analyze) {
+	SearchLimits limits;
+	for (size_t i = 1; i + 1 < words.size(); i += 2) {
+		if (words[i] == "movetime") limits.movetime = atol(words[i + 1].c_str());
+		else if (words[i] == "depth") limits.depth = atoi(words[i + 1].c_str());
+		else if (words[i] == "nodes") limits.nodes = atol(words[i + 1].c_str());
+		// infinite takes no value
+		else i--;
+	}
+	bool limited = limits.movetime > 0 || limits.depth > 0 || limits.nodes > 0;
+
+	int number = ++searchesRun;
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		if (player == NULL || playerSide != toMove) {
+			delete player;
+			player = newPlayer(toMove, options);
+			playerSide = toMove;
+		}
+		player->setPosition(black, white);
+		// A stop may have come in before the search started
+		player->setStop(stoppedUpTo >= number || (!limited && inputClosed));
+		unlimited = !limited;
+	}
+	analyzing = analyze;
+	SearchInfo lines[64];
+	int best = -1;
+	if (player->searchLines(limits, options.multiPv, lines, report, this) > 0) best = lines[0].pv[0];
+	analyzing = false;
+
+	// An unlimited search that has solved the game still waits for stop
+	if (!limited) {
+		std::unique_lock<std::mutex> guard(lock);
+		ready.wait(guard, [this, number] { return stoppedUpTo >= number || inputClosed; });
+	}
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		unlimited = false;
+	}
+	cout << "bestmove " << squareName(best) << endl;
+}
+
+/*
+ * Prints an info line for a finished depth, or while analyzing for the
+ * progress of the current one.
+ */
+void Protocol::report(void *context, const SearchInfo &info) {
+	Protocol *protocol = (Protocol *) context;
+	if (!info.complete && !protocol->analyzing) return;
+	long nps = (info.ms > 0) ? info.nodes * 1000 / info.ms : 0;
+	cout << "info";
+	if (info.depth > 0) cout << " depth " << info.depth;
+	if (info.complete && protocol->options.multiPv > 1) cout << " multipv " << info.line;
+	if (info.complete && info.depth > 0) cout << " score " << info.score;
+	cout << " nodes " << info.nodes << " time " << info.ms << " nps " << nps;
+	if (info.evalHits >= 0) cout << " evalhits " << info.evalHits;
+	if (info.pvLength > 0) {
+		cout << " pv";
+		for (int i = 0; i < info.pvLength; i++) cout << " " << squareName(info.pv[i]);
+	}
+	cout << endl;
+}
+
+/*
+ * setoption name <name> value <value>, or setoption <name> <value>.
+ */
+void Protocol::setOption(const std::vector<std::string> &words) {
+	std::string name, value;
+	if (words.size() >= 5 && words[1] == "name" && words[3] == "value") {
+		name = words[2];
+		value = words[4];
+	}
+	else if (words.size() >= 3) {
+		name = words[1];
+		value = words[2];
+	}
+	for (size_t i = 0; i < name.size(); i++) name[i] |= 0x20;
+	if (name == "threads") options.threads = atoi(value.c_str());
+	else if (name == "hash") options.hashMB = atoi(value.c_str());
+	else if (name == "search") options.mcts = (value == "mcts");
+	else if (name == "lmr") options.params.lateMoveReductions = (value == "true" || value == "on");
+	else if (name == "futility") {
+		options.params.futilityMargin = atoi(value.c_str());
+		options.params.futility = options.params.futilityMargin > 0;
+	}
+	else if (name == "multipv") {
+		options.multiPv = atoi(value.c_str());
+		if (options.multiPv > 64) options.multiPv = 64;
+	}
+	else if (name == "razor") {
+		options.params.razorMargin = atoi(value.c_str());
+		options.params.razoring = options.params.razorMargin > 0;
+	}
+	// A seed makes the Monte Carlo threads take turns; 0 lets them race
+	else if (name == "seed") {
+		options.seed = strtoull(value.c_str(), NULL, 10);
+		options.deterministic = options.seed != 0;
+	}
+	else {
+		cout << "info string unknown option " << name << endl;
+		return;
+	}
+	if (name == "hash" && !options.mcts) cout << "info string hash sizes the mcts tree only" << endl;
+	if (options.threads < 1) options.threads = 1;
+	if (options.hashMB < 1) options.hashMB = 1;
+	if (options.multiPv < 1) options.multiPv = 1;
+	resetPlayer();
+}
+
+/*
+ * Drops the player, so the next search starts with fresh tables and the
+ * current options.
+ */
+void Protocol::resetPlayer() {
+	std::lock_guard<std::mutex> guard(lock);
+	delete player;
+	player = NULL;
+}
+
+/*
+ * Reads a position as written in a position file: 64 squares a1 b1 ... h8
+ * (spaces between them allowed) and the side to move, with the same
+ * letters as the position command. Returns false if the text holds none.
+ */
+static bool parsePositionText(const std::string &text, uint64_t *black, uint64_t *white, Side *side) {
+	int squares = 0;
+	size_t i = 0;
+	*black = *white = 0;
+	for (; i < text.size() && squares < 64; i++) {
+		char c = text[i];
+		if (c == ' ' || c == '\t') continue;
+		if (c == 'X' || c == 'x' || c == 'b' || c == '*') *black |= 1ULL << squares;
+		else if (c == 'O' || c == 'o' || c == 'w') *white |= 1ULL << squares;
+		squares++;
+	}
+	while (i < text.size() && (text[i] == ' ' || text[i] == '\t')) i++;
+	if (squares < 64 || i >= text.size()) return false;
+	char c = text[i];
+	*side = (c == 'X' || c == 'x' || c == 'b' || c == '*' || c == 'B') ? BLACK : WHITE;
+	return true;
+}
+
+/*
+ * What a batch search heard about its last finished depth.
+ */
+struct BatchResult
+{
+	int depth;
+	int score;
+	long nodes;
+};
+
+static void batchReport(void *context, const SearchInfo &info) {
+	if (!info.complete || info.line != 1) return;
+	BatchResult *result = (BatchResult *) context;
+	result->depth = info.depth;
+	result->score = info.score;
+	result->nodes = info.nodes;
+}
+
+/*
+ * The worker side of sharded analysis: reads lines "<id> <position>", the
+ * position as in a position file, and answers each with
+ * "<id> <move> <score> <depth> <nodes>" once it has been searched within
+ * the limits, the move being "pass" if there is none. Every position gets
+ * a fresh player. A line that holds no position is answered with
+ * "<id> error".
+ */
+void runBatch(const EngineOptions &options, const SearchLimits &limits) {
+	std::string line;
+	while (getline(cin, line)) {
+		std::istringstream in(line);
+		std::string id, text;
+		if (!(in >> id)) continue;
+		getline(in, text);
+		uint64_t black, white;
+		Side side;
+		if (!parsePositionText(text, &black, &white, &side)) {
+			cout << id << " error" << endl;
+			continue;
+		}
+		Player *player = newPlayer(side, options);
+		player->setPosition(black, white);
+		BatchResult result = {0, 0, 0};
+		int best = player->search(limits, batchReport, &result);
+		delete player;
+		cout << id << " " << squareName(best) << " " << result.score << " " << result.depth << " " << result.nodes << endl;
+	}
+}
@@ -0,0 +1,114 @@
+#ifndef __PROTOCOL_H__
+#define __PROTOCOL_H__
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "common.h"
+#include "player.h"
+
+/**
+ * Everything the engine was started with, applied to every player made for
+ * it.
+ */
+struct EngineOptions
+{
+	SolveCache *cache;
+	// Shared by every player, as the weights are
+	EvalCache *evalCache;
+	const EvalWeights *weights;
+	const Network *network;
+	SearchParams params;
+	bool mcts;
+	int threads;
+	// Size of the Monte Carlo tree. Negascout keeps no table in memory
+	// besides the persistent cache, so it takes no notice.
+	int hashMB;
+	// How many of the best moves a search reports on
+	int multiPv;
+	// Whether the Monte Carlo threads take turns, and their seed
+	bool deterministic;
+	uint64_t seed;
+	EngineOptions() {
+		cache = NULL;
+		evalCache = NULL;
+		weights = NULL;
+		network = NULL;
+		mcts = false;
+		threads = 1;
+		hashMB = 56;
+		multiPv = 1;
+		deterministic = false;
+		seed = 1;
+	}
+};
+
+Player *newPlayer(Side side, const EngineOptions &options);
+void runBatch(const EngineOptions &options, const SearchLimits &limits);
+
+/**
+ * A text protocol for scripts and GUIs, in the spirit of UCI:
+ *
+ *   uci                          names the engine and its options
+ *   isready                      answers readyok
+ *   newgame                      starts over from the opening position
+ *   position startpos|<64 squares> <b|w> [moves d3 c5 pass ...]
+ *   go [movetime ms] [depth d] [nodes n] [infinite]
+ *                                searches and answers "bestmove d3"; with
+ *                                multipv above 1, the info lines of each
+ *                                depth give that many best moves
+ *   analyze                      like go infinite, with an info line
+ *                                every second
+ *   stop                         ends the search at once
+ *   setoption name <threads|hash|search|lmr|futility|razor|multipv|seed> value <v>
+ *                                hash is the Monte Carlo tree in megabytes,
+ *                                and only matters with search mcts
+ *   quit
+ *
+ * Lines are read on their own thread, so stop and quit take effect while a
+ * search runs, and stop every search asked for before them; everything else
+ * waits its turn. At the end of the input the commands already given are
+ * finished first, so a script can pipe in a list of searches.
+ */
+class Protocol {
+	EngineOptions options;
+	Player *player;
+	Side playerSide;
+	uint64_t black, white;
+	Side toMove;
+	bool analyzing;
+
+	std::thread input;
+	std::mutex lock;
+	std::condition_variable ready;
+	std::deque<std::string> commands;
+	// go and analyze commands read, the number up to which they have been
+	// stopped, and the number run so far
+	int searchesRead;
+	int stoppedUpTo;
+	int searchesRun;
+	// Whether the running search has no limits, and whether the input has
+	// ended
+	bool unlimited;
+	bool inputClosed;
+
+	void readInput();
+	void enqueue(const std::string &line);
+	void requestStop();
+	bool execute(const std::string &line);
+	void setPosition(const std::vector<std::string> &words);
+	void go(const std::vector<std::string> &words, bool analyze);
+	void setOption(const std::vector<std::string> &words);
+	void resetPlayer();
+	static void report(void *context, const SearchInfo &info);
+
+public:
+	Protocol(const EngineOptions &options);
+	~Protocol();
+	void run(const std::string &firstLine);
+};
+
+#endif
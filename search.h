@@ -0,0 +1,527 @@
+#ifndef __SEARCH_H__
+#define __SEARCH_H__
+
+#include <climits>
+#include <cstdlib>
+#include <time.h>
+#include "board.h"
+#include "bitboard.h"
+#include "symmetry.h"
+
+/*
+ * The one search of the board, put together at compile time from five
+ * parts, each a struct of constants and static functions:
+ *
+ *   Evaluator  scores the positions the search stops at
+ *   Orderer    sorts the moves of a node, and says whether the line of the
+ *              last search goes first
+ *   Table      remembers positions searched before
+ *   Pruning    the window logic: plain minimax, alpha beta, or negascout
+ *              with its null windows and selective cuts
+ *   Stop       when to give up and leave the search
+ *
+ * Board::search<Policy> calls the parts of its policy directly, so every
+ * combination compiles to a loop of its own with the parts inlined and the
+ * branches they rule out folded away. A new idea is a new part and one
+ * more typedef at the bottom, not another copy of the search.
+ */
+
+template <class E, class O, class T, class P, class S>
+struct SearchPolicy
+{
+	typedef E Evaluator;
+	typedef O Orderer;
+	typedef T Table;
+	typedef P Pruning;
+	typedef S Stop;
+};
+
+/**
+ * Counts the plies from the root for as long as a search call lasts.
+ */
+struct PlyGuard
+{
+	int &count;
+	int here;
+	PlyGuard(int &c) : count(c), here(c) {
+		count++;
+	}
+	~PlyGuard() {
+		count--;
+	}
+};
+
+/*
+ * Evaluators score the board for player (1 for us, -1 for the opponent).
+ * exact gives the whole score; bounded may stop short once the score is
+ * known to fall outside alpha to beta. scoreChildren scores the positions
+ * after every move in list at once, returning false if it cannot.
+ */
+
+// Our discs less theirs, which is all the testing player knows
+struct DiscEvaluator
+{
+	static inline int exact(Board &board, int player) {
+		return board.basicHeuristic()*player;
+	}
+	static inline int bounded(Board &board, int player, int, int) {
+		return exact(board, player);
+	}
+	static inline bool scoreChildren(Board &, Side, const int *, int, int, int, int, int *) {
+		return false;
+	}
+};
+
+// The full evaluation, or the network if the board has one
+struct FullEvaluator
+{
+	static inline int exact(Board &board, int player) {
+		return board.betterHeuristic()*player;
+	}
+	static inline int bounded(Board &board, int player, int, int) {
+		return exact(board, player);
+	}
+	static inline bool scoreChildren(Board &, Side, const int *, int, int, int, int, int *) {
+		return false;
+	}
+};
+
+// The full evaluation, skipping the costly terms outside the window when
+// the search parameters allow, and scoring frontier nodes in one batch
+struct LazyEvaluator
+{
+	static inline int exact(Board &board, int player) {
+		return board.betterHeuristic()*player;
+	}
+	static inline int bounded(Board &board, int player, int alpha, int beta) {
+		if (!board.params.lazyEval) return exact(board, player);
+		return (player == 1) ? board.betterHeuristic(alpha, beta) : -board.betterHeuristic(-beta, -alpha);
+	}
+	// The network is kept up to date move by move, so its children still
+	// have to be played
+	static inline bool scoreChildren(Board &board, Side side, const int *list, int numMoves, int player,
+		int alpha, int beta, int *scores) {
+		if (board.network != NULL) return false;
+		int low = INT_MIN, high = INT_MAX;
+		if (board.params.lazyEval) {
+			low = (player == 1) ? alpha : -beta;
+			high = (player == 1) ? beta : -alpha;
+		}
+		board.scoreMoves(side, list, numMoves, low, high, scores);
+		for (int k = 0; k < numMoves; k++) scores[k] *= player;
+		return true;
+	}
+};
+
+/*
+ * Orderers sort the moves of a node for player before they are searched.
+ * With FOLLOW_PV, the line of the last search is then tried first.
+ */
+
+// The order the moves were generated in
+struct GeneratedOrder
+{
+	static const bool FOLLOW_PV = false;
+	static inline void order(Board &, Side, int *, int, int, int) {}
+};
+
+// Good squares first; deep enough, by what the static evaluation makes
+// of each child
+struct EvalOrder
+{
+	static const bool FOLLOW_PV = true;
+	static inline void order(Board &board, Side side, int *list, int numMoves, int depth, int player) {
+		if (board.params.evalOrdering && depth >= board.params.evalOrderDepth && board.network == NULL) {
+			int scores[64];
+			board.scoreMoves(side, list, numMoves, INT_MIN, INT_MAX, scores);
+			board.orderMoves(list, numMoves, scores, player);
+		}
+		else board.orderMoves(list, numMoves);
+	}
+};
+
+/*
+ * Tables. probe looks the position up before it is searched, filling in
+ * slot for the store that follows the search. It returns true, with the
+ * score and the move, if a stored result settles the node; otherwise it
+ * may set move to one worth trying first. store saves a result with its
+ * bound (one of the CACHE_ kinds) and best move, 64 if there is none.
+ */
+
+struct NoTable
+{
+	struct Slot {};
+	static inline bool probe(Board &, Slot &, Side, int, int, int, int *, int *) {
+		return false;
+	}
+	static inline void store(Board &, const Slot &, int, int, int, int) {}
+};
+
+// The small lists the board keeps itself, indexed by the opponent's disc
+// count. They hold no bounds, so only suggest a move to start with.
+struct HintTable
+{
+	struct Slot
+	{
+		bool used;
+		int hashVal;
+		uint64_t black, taken;
+		Slot() : used(false), hashVal(0), black(0), taken(0) {}
+	};
+	static inline bool probe(Board &board, Slot &slot, Side, int, int, int, int *, int *move) {
+		slot.used = true;
+		slot.hashVal = board.hashFind();
+		slot.black = board.getBlack();
+		slot.taken = slot.black | board.getWhite();
+		int val = board.findInHashTable(slot.hashVal, slot.black, slot.taken);
+		if (val != -1 && abs(val)%100 < 64) *move = abs(val)%100;
+		return false;
+	}
+	static inline void store(Board &board, const Slot &slot, int, int, int score, int move) {
+		if (slot.used) board.addToHashTable(slot.hashVal, slot.black, slot.taken, (move < 64) ? move : 66, score);
+	}
+};
+
+// Up to this many discs, positions are cached under their canonical key,
+// so one entry serves every orientation of an opening
+#define CANONICAL_DISCS 20
+
+// The persistent cache shared with earlier games, if the board has one.
+// A move stored under a canonical key is for the canonical orientation,
+// so it goes through the symmetry on the way in and back out again.
+struct CacheTable
+{
+	struct Slot
+	{
+		uint64_t key;
+		int symmetry;
+		Slot() : key(0), symmetry(0) {}
+	};
+	static inline bool probe(Board &board, Slot &slot, Side side, int depth, int alpha, int beta,
+		int *score, int *move) {
+		if (board.cache == NULL || depth < board.cache->minDepth) return false;
+		if (popcount(board.getBlack() | board.getWhite()) <= CANONICAL_DISCS)
+			slot.key = board.canonicalKey(side, &slot.symmetry);
+		else slot.key = board.zobristKey(side);
+		CacheEntry entry;
+		if (board.cache->probe(slot.key, &entry) && entry.depth >= depth &&
+			(entry.bound == CACHE_EXACT ||
+			(entry.bound == CACHE_LOWER && entry.score >= beta) ||
+			(entry.bound == CACHE_UPPER && entry.score <= alpha))) {
+			*score = entry.score;
+			*move = (entry.move < 64) ? transformSquare(entry.move, inverseSymmetry(slot.symmetry)) : entry.move;
+			return true;
+		}
+		return false;
+	}
+	static inline void store(Board &board, const Slot &slot, int depth, int bound, int score, int move) {
+		if (slot.key == 0) return;
+		if (move < 64) move = transformSquare(move, slot.symmetry);
+		board.cacheResult(slot.key, depth, bound, score, move);
+	}
+};
+
+/*
+ * Pruning rules. Without CUTOFFS every move is searched to the end;
+ * SCOUT searches all but the first move with a null window first; and
+ * SELECTIVE allows the late move reductions, futility pruning and razoring
+ * the search parameters turn on.
+ */
+
+struct MinimaxPruning
+{
+	static const bool CUTOFFS = false;
+	static const bool SCOUT = false;
+	static const bool SELECTIVE = false;
+};
+
+struct AlphaBetaPruning
+{
+	static const bool CUTOFFS = true;
+	static const bool SCOUT = false;
+	static const bool SELECTIVE = false;
+};
+
+struct ScoutPruning
+{
+	static const bool CUTOFFS = true;
+	static const bool SCOUT = true;
+	static const bool SELECTIVE = true;
+};
+
+/*
+ * Stop conditions. aborted is checked at every node, with the seconds the
+ * calls above it have taken, which are only counted if TIMED.
+ */
+
+struct NoStop
+{
+	static const bool TIMED = false;
+	static inline bool aborted(Board &, double) {
+		return false;
+	}
+};
+
+// The old four minute limit on a single search
+struct ClockStop
+{
+	static const bool TIMED = true;
+	static inline bool aborted(Board &, double timeTaken) {
+		return timeTaken > 240;
+	}
+};
+
+// That, and the stop request, node limit and deadline of the board
+struct LimitStop
+{
+	static const bool TIMED = true;
+	static inline bool aborted(Board &board, double timeTaken) {
+		return timeTaken > 240 || board.searchAborted();
+	}
+};
+
+// Only the limits of the board, never reading the clock itself, so that
+// with no deadline the same search visits the same nodes every time
+struct BoardStop
+{
+	static const bool TIMED = false;
+	static inline bool aborted(Board &board, double) {
+		return board.searchAborted();
+	}
+};
+
+/*
+ * Moves move to the front of a move list, if it is there, keeping the
+ * order of the others.
+ */
+static inline void moveToFront(int *list, int numMoves, int move) {
+	for (int k = 1; k < numMoves; k++) {
+		if (list[k] != move) continue;
+		for (; k > 0; k--) list[k] = list[k - 1];
+		list[0] = move;
+		return;
+	}
+}
+
+/*
+ * The seconds since startTime, on top of those the calls above took, if
+ * the search keeps time at all.
+ */
+template <bool TIMED>
+static inline double elapsed(time_t startTime, double timeTaken) {
+	if (!TIMED) return 0;
+	time_t now;
+	time(&now);
+	return difftime(now, startTime) + timeTaken;
+}
+
+/*
+ * Searches the board to depth for player (1 for us, -1 for the opponent)
+ * within the window alpha to beta, returning the score for player. At the
+ * top level the move to make is left in moveToDo and the line found in the
+ * principal variation. If the search is stopped it returns 65 with
+ * moveToDo->x set to -3.
+ */
+template <class Policy>
+int Board::search(int depth, int alpha, int beta, int player, bool topLevel, bool firstChild, double timeTaken) {
+	typedef typename Policy::Evaluator Eval;
+	typedef typename Policy::Orderer Order;
+	typedef typename Policy::Table Table;
+	typedef typename Policy::Pruning Prune;
+	typedef typename Policy::Stop Stop;
+	nodes++;
+	if (topLevel) startPrincipalVariation();
+	PlyGuard guard(ply);
+	int here = guard.here;
+	if (here >= MAX_PLY) return Eval::exact(*this, player);
+	pvLength[here] = here;
+	// Whether this node is on the line of the last search
+	bool onPv = Order::FOLLOW_PV && followPv;
+	followPv = false;
+	// If we have taken too much time or been told to stop, then leave
+	if (Stop::aborted(*this, timeTaken)) {
+		moveToDo->setX(-3);
+		return 65;
+	}
+	time_t startTime = 0;
+	if (Stop::TIMED) time(&startTime);
+	// Figures out which color the current move is for
+	Side side = (player == 1) ? mySelf : opp;
+	// If there are no valid moves for this player or we have reached
+	// maximum depth, return the score of the board right now
+	if ((hasMoves(side) == -1) || depth <= 0) return Eval::bounded(*this, player, alpha, beta);
+	// A multi-PV root keeps the best few moves rather than just the best,
+	// which the table knows nothing about
+	bool multi = topLevel && multiPv > 1;
+	if (multi) numRootLines = 0;
+	// See if the position was already searched deeply enough
+	int alphaOrig = alpha;
+	typename Table::Slot slot;
+	int hint = 64;
+	if (!multi) {
+		int score;
+		if (Table::probe(*this, slot, side, depth, alpha, beta, &score, &hint)) {
+			if (topLevel) {
+				moveToDo->setX(hint%8);
+				moveToDo->setY(hint/8);
+				pv[here][here] = hint;
+				pvLength[here] = here + 1;
+			}
+			return score;
+		}
+	}
+	int bestIndex = 64;
+	// Away from the principal variation and the exact endgame, a static score
+	// far outside the null window settles the node without a full search
+	bool selective = Prune::SELECTIVE && !topLevel && beta - alpha == 1 &&
+		depth < 64 - __builtin_popcountll(takenb);
+	if (selective && (params.futility || params.razoring)) {
+		int standPat = Eval::exact(*this, player);
+		if (params.futility && depth <= params.futilityDepth &&
+			standPat - params.futilityMargin*depth >= beta)
+			return standPat;
+		if (params.razoring && depth <= params.razorDepth &&
+			standPat + params.razorMargin*depth <= alpha) {
+			if (depth == 1) return standPat;
+			int score = search<Policy>(depth - 1, alpha, beta, player, false, firstChild,
+				elapsed<Stop::TIMED>(startTime, timeTaken));
+			if (abs(score) == 65 && moveToDo->x == -3) return 65;
+			if (score <= alpha) return score;
+		}
+	}
+
+	int moveList[64];
+	int numMoves = getMoves(side, moveList);
+	Order::order(*this, side, moveList, numMoves, depth, player);
+	// Then the move the table suggests, and at the root the move of the
+	// last search if it was not looking for lines
+	if (hint < 64) moveToFront(moveList, numMoves, hint);
+	if (topLevel && !multi && !onPv && moveToDo->x != -1 && moveToDo->y != -1) {
+		moveToFront(moveList, numMoves, moveToDo->x + moveToDo->y*8);
+		moveToDo->setX(-1);
+		moveToDo->setY(-1);
+	}
+	// And the move of the last search's line before all of them
+	onPv = onPv && here < prevPvLength;
+	if (onPv) moveToFront(moveList, numMoves, prevPv[here]);
+	// Or, at a multi-PV root, the moves of all the last search's lines
+	if (multi && Order::FOLLOW_PV) {
+		for (int i = numPrevRootLines - 1; i >= 0; i--) moveToFront(moveList, numMoves, prevRootLine[i][0]);
+	}
+	// A frontier node's children would only be scored, so if the evaluator
+	// can, score them all in one batch rather than playing each. Only
+	// whether a child beats the window matters, so lazily scored children
+	// can stop at a bound; alpha only goes up, so the starting window stays
+	// safe.
+	int leafScores[64];
+	if (depth == 1 && !topLevel &&
+		Eval::scoreChildren(*this, side, moveList, numMoves, player, alpha, beta, leafScores)) {
+		for (int k = 0; k < numMoves; k++) {
+			// Counted and checked as the child's own search would be
+			nodes++;
+			if (Stop::aborted(*this, timeTaken)) {
+				moveToDo->setX(-3);
+				return 65;
+			}
+			if (leafScores[k] > alpha) {
+				alpha = leafScores[k];
+				bestIndex = moveList[k];
+				if (here + 1 < MAX_PLY) pvLength[here + 1] = here + 1;
+				updatePrincipalVariation(here, moveList[k]);
+			}
+			if (Prune::CUTOFFS && alpha >= beta) break;
+		}
+		int bound = (alpha >= beta) ? CACHE_LOWER : (alpha > alphaOrig) ? CACHE_EXACT : CACHE_UPPER;
+		Table::store(*this, slot, depth, bound, alpha, (alpha > alphaOrig) ? bestIndex : 64);
+		return alpha;
+	}
+	bool reduce = Prune::SELECTIVE && params.lateMoveReductions && !topLevel &&
+		depth >= params.lmrDepth && depth < 64 - __builtin_popcountll(takenb);
+	bool first = true;
+	for (int k = 0; k < numMoves; k++) {
+		Move possMove(moveList[k]%8, moveList[k]/8);
+		// Do the move, and find the score of searching the board that
+		// leaves for the opposite player
+		doMove(&possMove, side);
+		double spent = elapsed<Stop::TIMED>(startTime, timeTaken);
+		followPv = onPv && moveList[k] == prevPv[here];
+		if (multi && Order::FOLLOW_PV) followPv = followRootLine(moveList[k]);
+		int score;
+		if (Prune::SCOUT) {
+			score = alpha + 1;
+			// A late move only gets the full search if a shallower one says
+			// it could beat alpha
+			if (!first && reduce && k >= params.lmrMoves)
+				score = -search<Policy>(depth - 1 - params.lmrReduction, -alpha - 1, -alpha, -player, false, first, spent);
+			if (score > alpha) {
+				// If it is not the first child, can do a narrow window search
+				// and adjust search acocrdingly
+				if (!first) {
+					score = -search<Policy>(depth - 1, -alpha - 1, -alpha, -player, false, first, spent);
+					if (score < beta && score > alpha)
+						score = -search<Policy>(depth - 1, -beta, -score, -player, false, first, spent);
+				}
+				else score = -search<Policy>(depth - 1, -beta, -alpha, -player, false, first, spent);
+			}
+		}
+		else score = -search<Policy>(depth - 1, -beta, -alpha, -player, false, first, spent);
+		first = false;
+		if (abs(score) == 65 && moveToDo->x == -3) {
+			undoMove();
+			return 65;
+		}
+		// A move good enough for the best lines gets one of them. Until
+		// there are enough lines every move is searched with the full
+		// window; after that, moves only have to beat the worst line.
+		if (multi) {
+			if (score > alpha) addRootLine(moveList[k], score);
+			first = numRootLines < multiPv;
+			alpha = first ? alphaOrig : rootScore[multiPv - 1];
+		}
+		// If this move yields a higher score than so far, do
+		// it and if we are in the top level of recursion, change
+		// the move we must to do to this move
+		else if (score > alpha) {
+			alpha = score;
+			bestIndex = moveList[k];
+			updatePrincipalVariation(here, moveList[k]);
+			if (topLevel) {
+				moveToDo->setX(possMove.getX());
+				moveToDo->setY(possMove.getY());
+			}
+		}
+		undoMove();
+		// If the score is at least beta, we know our opponent never would
+		// have let us do this well, so the rest of the moves can go
+		if (Prune::CUTOFFS && alpha >= beta) {
+			Table::store(*this, slot, depth, CACHE_LOWER, alpha, bestIndex);
+			return alpha;
+		}
+	}
+	// The best of the lines is the result, as for a single line
+	if (multi && numRootLines > 0) {
+		for (int i = 0; i < rootLength[0]; i++) pv[0][i] = rootLine[0][i];
+		pvLength[0] = rootLength[0];
+		moveToDo->setX(rootLine[0][0]%8);
+		moveToDo->setY(rootLine[0][0]/8);
+		alpha = rootScore[0];
+	}
+	if (alpha > alphaOrig) Table::store(*this, slot, depth, CACHE_EXACT, alpha, bestIndex);
+	else Table::store(*this, slot, depth, CACHE_UPPER, alpha, 64);
+	return alpha;
+}
+
+/*
+ * The searches the board offers.
+ */
+typedef SearchPolicy<DiscEvaluator, GeneratedOrder, NoTable, MinimaxPruning, NoStop> DiscMinimaxSearch;
+typedef SearchPolicy<FullEvaluator, GeneratedOrder, NoTable, MinimaxPruning, NoStop> MinimaxSearch;
+typedef SearchPolicy<FullEvaluator, GeneratedOrder, HintTable, AlphaBetaPruning, ClockStop> AlphaBetaSearch;
+typedef SearchPolicy<LazyEvaluator, EvalOrder, CacheTable, ScoutPruning, LimitStop> NegascoutSearch;
+
+// Any of them stopped by the board's limits alone
+template <class Policy>
+using UntimedSearch = SearchPolicy<typename Policy::Evaluator, typename Policy::Orderer,
+	typename Policy::Table, typename Policy::Pruning, BoardStop>;
+
+#endif
@@ -0,0 +1,352 @@
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "server.h"
+
+Server::Server(const EngineOptions &options, GameLog *log, int workers) {
+	this->options = options;
+	this->log = log;
+	numWorkers = (workers < 1) ? 1 : workers;
+	searching = 0;
+	shuttingDown = false;
+	closing = false;
+	for (int i = 0; i < numWorkers; i++) this->workers.push_back(std::thread(&Server::worker, this));
+}
+
+/*
+ * Waits for the workers, ending the games still going.
+ */
+Server::~Server() {
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		closing = true;
+		work.notify_all();
+	}
+	for (size_t i = 0; i < workers.size(); i++) workers[i].join();
+	std::map<std::pair<Connection *, std::string>, ServerGame *>::iterator it;
+	for (it = games.begin(); it != games.end(); ++it) {
+		it->second->player->gameOver();
+		delete it->second->player;
+		delete it->second;
+	}
+}
+
+/*
+ * Serves games over standard input and output until the input ends, then
+ * waits for the searches still asked for.
+ */
+void Server::runStdin() {
+	Connection *connection = new Connection();
+	connection->fd = STDOUT_FILENO;
+	connection->closed = false;
+	connection->games = 0;
+	std::string line;
+	while (!shuttingDown && getline(cin, line)) handleLine(connection, line);
+	drain();
+	closeConnection(connection);
+	delete connection;
+}
+
+/*
+ * Serves games to any number of clients of a Unix socket at path until one
+ * of them sends shutdown. Returns false if the socket cannot be made.
+ */
+bool Server::runSocket(const char *path) {
+	int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	struct sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (listener < 0 || strlen(path) >= sizeof(address.sun_path)) return false;
+	strcpy(address.sun_path, path);
+	unlink(path);
+	if (bind(listener, (struct sockaddr *) &address, sizeof(address)) != 0 || listen(listener, 64) != 0) {
+		close(listener);
+		return false;
+	}
+
+	std::vector<Connection *> connections;
+	std::vector<std::thread> readers;
+	while (!shuttingDown) {
+		// Look up now and then to see if we were told to shut down
+		struct pollfd waiting = {listener, POLLIN, 0};
+		if (poll(&waiting, 1, 200) <= 0) continue;
+		int fd = accept(listener, NULL, NULL);
+		if (fd < 0) continue;
+		Connection *connection = new Connection();
+		connection->fd = fd;
+		connection->closed = false;
+		connection->games = 0;
+		connections.push_back(connection);
+		readers.push_back(std::thread(&Server::serve, this, connection));
+	}
+	close(listener);
+	unlink(path);
+	drain();
+
+	// Wake the readers of clients still connected
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		for (size_t i = 0; i < connections.size(); i++)
+			if (connections[i]->fd >= 0) shutdown(connections[i]->fd, SHUT_RDWR);
+	}
+	for (size_t i = 0; i < readers.size(); i++) readers[i].join();
+	for (size_t i = 0; i < connections.size(); i++) delete connections[i];
+	return true;
+}
+
+/*
+ * Reads the lines of one client until it goes away.
+ */
+void Server::serve(Connection *connection) {
+	std::string buffer;
+	char chunk[4096];
+	while (true) {
+		ssize_t n = read(connection->fd, chunk, sizeof(chunk));
+		if (n <= 0) break;
+		buffer.append(chunk, n);
+		size_t end;
+		while ((end = buffer.find('\n')) != std::string::npos) {
+			handleLine(connection, buffer.substr(0, end));
+			buffer.erase(0, end + 1);
+		}
+	}
+	closeConnection(connection);
+}
+
+/*
+ * Ends every game of a client that went away.
+ */
+void Server::closeConnection(Connection *connection) {
+	std::lock_guard<std::mutex> guard(lock);
+	{
+		std::lock_guard<std::mutex> output(outputLock);
+		connection->closed = true;
+	}
+	std::map<std::pair<Connection *, std::string>, ServerGame *>::iterator it = games.begin();
+	while (it != games.end()) {
+		ServerGame *game = it->second;
+		if (game->connection != connection) {
+			++it;
+			continue;
+		}
+		games.erase(it++);
+		endGame(game);
+	}
+	if (connection->games == 0 && connection->fd >= 0 && connection->fd != STDOUT_FILENO) {
+		close(connection->fd);
+		connection->fd = -1;
+	}
+}
+
+/*
+ * Waits until no request is waiting or being searched.
+ */
+void Server::drain() {
+	std::unique_lock<std::mutex> guard(lock);
+	work.wait(guard, [this] { return ready.empty() && searching == 0; });
+}
+
+static std::vector<std::string> split(const std::string &line) {
+	std::vector<std::string> words;
+	std::istringstream in(line);
+	std::string word;
+	while (in >> word) words.push_back(word);
+	return words;
+}
+
+void Server::handleLine(Connection *connection, const std::string &line) {
+	std::vector<std::string> words = split(line);
+	if (words.empty()) return;
+	if (words[0] == "shutdown") {
+		std::lock_guard<std::mutex> guard(lock);
+		shuttingDown = true;
+		return;
+	}
+	if (words.size() < 2) {
+		reply(connection, words[0] + " error no command");
+		return;
+	}
+	const std::string &id = words[0], &command = words[1];
+
+	std::unique_lock<std::mutex> guard(lock);
+	std::pair<Connection *, std::string> key(connection, id);
+	std::map<std::pair<Connection *, std::string>, ServerGame *>::iterator found = games.find(key);
+	ServerGame *game = (found == games.end()) ? NULL : found->second;
+
+	if (command == "new") {
+		if (game != NULL || words.size() < 3) {
+			guard.unlock();
+			reply(connection, id + " error cannot start game");
+			return;
+		}
+		game = new ServerGame();
+		game->id = id;
+		game->connection = connection;
+		Side side = (words[2] == "black" || words[2] == "Black") ? BLACK : WHITE;
+		game->player = newPlayer(side, options);
+		if (log != NULL) game->player->setLog(log);
+		game->movesPlayed = (side == BLACK) ? 0 : 1;
+		game->busy = false;
+		game->ended = false;
+		connection->games++;
+		games[key] = game;
+		guard.unlock();
+		reply(connection, id + " ok");
+	}
+	else if (command == "move" && game != NULL && words.size() >= 5) {
+		MoveRequest request;
+		request.x = atoi(words[2].c_str());
+		request.y = atoi(words[3].c_str());
+		request.msLeft = atol(words[4].c_str());
+		// The soft budget of this move, going by the moves played so far;
+		// without a clock, a second
+		long budget = 1000;
+		if (request.msLeft >= 0) {
+			int empty = 60 - 2*(game->movesPlayed + (int) game->requests.size());
+			if (empty < 2) empty = 2;
+			TimeManager clock;
+			clock.startMove(request.msLeft, empty);
+			budget = clock.softLimit();
+		}
+		request.received = std::chrono::steady_clock::now();
+		request.deadline = request.received + std::chrono::milliseconds(budget);
+		game->requests.push_back(request);
+		// A busy game is scheduled again when its search is done
+		if (!game->busy && game->requests.size() == 1) schedule(game);
+	}
+	else if (command == "end" && game != NULL) {
+		games.erase(found);
+		endGame(game);
+	}
+	else {
+		guard.unlock();
+		reply(connection, id + " error " + (game == NULL ? "no such game" : "bad command"));
+	}
+}
+
+/*
+ * Puts a game with a request waiting in line for a worker. Called with the
+ * lock held.
+ */
+void Server::schedule(ServerGame *game) {
+	ready.push_back(game);
+	work.notify_one();
+}
+
+/*
+ * Takes the game whose next request has the earliest deadline out of the
+ * line. Called with the lock held and the line not empty.
+ */
+ServerGame *Server::nextGame() {
+	size_t best = 0;
+	for (size_t i = 1; i < ready.size(); i++) {
+		if (ready[i]->requests.front().deadline < ready[best]->requests.front().deadline) best = i;
+	}
+	ServerGame *game = ready[best];
+	ready.erase(ready.begin() + best);
+	return game;
+}
+
+/*
+ * Ends a game already taken out of the games map. A game being searched is
+ * freed by its worker once the search is done; any other is taken out of
+ * the line, so no worker picks it up, and freed now. Called with the lock
+ * held.
+ */
+void Server::endGame(ServerGame *game) {
+	game->ended = true;
+	if (game->busy) return;
+	for (size_t i = 0; i < ready.size(); i++) {
+		if (ready[i] != game) continue;
+		ready.erase(ready.begin() + i);
+		break;
+	}
+	finish(game);
+	// drain may be waiting for the line to empty
+	work.notify_all();
+}
+
+/*
+ * Frees an ended game. Called with the lock held.
+ */
+void Server::finish(ServerGame *game) {
+	game->player->gameOver();
+	delete game->player;
+	Connection *connection = game->connection;
+	connection->games--;
+	if (connection->closed && connection->games == 0 && connection->fd >= 0 && connection->fd != STDOUT_FILENO) {
+		close(connection->fd);
+		connection->fd = -1;
+	}
+	delete game;
+}
+
+/*
+ * One thread of the pool: searches for whichever game is due first.
+ */
+void Server::worker() {
+	std::unique_lock<std::mutex> guard(lock);
+	while (true) {
+		work.wait(guard, [this] { return closing || !ready.empty(); });
+		if (ready.empty()) return;
+		ServerGame *game = nextGame();
+		MoveRequest request = game->requests.front();
+		game->requests.pop_front();
+		game->busy = true;
+		searching++;
+		guard.unlock();
+
+		// The clock ran while the request waited; without a clock search a
+		// fixed depth
+		Move opponentsMove(request.x, request.y);
+		Move *last = (request.x >= 0 && request.y >= 0) ? &opponentsMove : NULL;
+		Move *move;
+		if (request.msLeft >= 0) {
+			long waited = std::chrono::duration_cast<std::chrono::milliseconds>(
+				std::chrono::steady_clock::now() - request.received).count();
+			move = game->player->playClock(last, request.msLeft - waited);
+		}
+		else {
+			SearchLimits limits;
+			limits.depth = 8;
+			move = game->player->playMove(last, limits);
+		}
+		std::ostringstream text;
+		text << game->id << " ";
+		if (move != NULL) text << move->x << " " << move->y;
+		else text << "-1 -1";
+		reply(game->connection, text.str());
+
+		guard.lock();
+		searching--;
+		game->busy = false;
+		game->movesPlayed++;
+		if (game->ended) finish(game);
+		else if (!game->requests.empty()) schedule(game);
+		work.notify_all();
+	}
+}
+
+/*
+ * Sends one line to a connection, if it is still there.
+ */
+void Server::reply(Connection *connection, const std::string &text) {
+	std::lock_guard<std::mutex> guard(outputLock);
+	if (connection->closed) return;
+	if (connection->fd == STDOUT_FILENO) {
+		cout << text << endl;
+		return;
+	}
+	std::string line = text + "\n";
+	size_t sent = 0;
+	while (sent < line.size()) {
+		ssize_t n = send(connection->fd, line.data() + sent, line.size() - sent, MSG_NOSIGNAL);
+		if (n <= 0) break;
+		sent += n;
+	}
+}
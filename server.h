@@ -0,0 +1,111 @@
+#ifndef __SERVER_H__
+#define __SERVER_H__
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <atomic>
+#include "common.h"
+#include "player.h"
+#include "protocol.h"
+
+/**
+ * Where lines for a game came from and its replies go: standard output or
+ * one client of the socket.
+ */
+struct Connection
+{
+	int fd;
+	bool closed;
+	// Games of this connection still hosted
+	int games;
+};
+
+/**
+ * A request for the engine's move in one game.
+ */
+struct MoveRequest
+{
+	int x, y;
+	long msLeft;
+	// When the request came in, and when the reply should be sent going by
+	// the game's clock
+	std::chrono::steady_clock::time_point received;
+	std::chrono::steady_clock::time_point deadline;
+};
+
+/**
+ * One game hosted by the server, with its own player and so its own board
+ * and tables. Requests for it are handled in order, one at a time.
+ */
+struct ServerGame
+{
+	std::string id;
+	Connection *connection;
+	Player *player;
+	std::deque<MoveRequest> requests;
+	int movesPlayed;
+	bool busy;
+	bool ended;
+};
+
+/**
+ * Hosts many games in one process. The weights, network, Zobrist keys and
+ * persistent cache are loaded once and shared; each game gets its own
+ * player. Lines name their game first:
+ *
+ *   <id> new black|white     start a game with the engine playing that side
+ *   <id> move x y msLeft     the opponent's move (-1 -1 for none) and the
+ *                            engine's time left (-1 for no clock); the
+ *                            reply is "<id> x y", "-1 -1" for a pass
+ *   <id> end                 the game is over
+ *   shutdown                 stop once every search asked for is done
+ *
+ * A fixed pool of threads searches for all the games. Waiting requests are
+ * served earliest deadline first, the deadline being the soft budget the
+ * time manager gives the move, so games short of time go first and no
+ * game waits for long behind a slow one. A move is searched with what is
+ * left of the clock once a worker takes it, shared out by the game's time
+ * manager as in a clocked doMove.
+ */
+class Server {
+	EngineOptions options;
+	GameLog *log;
+	int numWorkers;
+	std::vector<std::thread> workers;
+
+	std::mutex lock;
+	std::condition_variable work;
+	std::map<std::pair<Connection *, std::string>, ServerGame *> games;
+	// Games whose next request waits for a worker
+	std::vector<ServerGame *> ready;
+	int searching;
+	// Set by shutdown, and once the workers are to finish
+	std::atomic<bool> shuttingDown;
+	bool closing;
+	std::mutex outputLock;
+
+	void worker();
+	ServerGame *nextGame();
+	void schedule(ServerGame *game);
+	void endGame(ServerGame *game);
+	void finish(ServerGame *game);
+	void handleLine(Connection *connection, const std::string &line);
+	void reply(Connection *connection, const std::string &text);
+	void serve(Connection *connection);
+	void closeConnection(Connection *connection);
+	void drain();
+
+public:
+	Server(const EngineOptions &options, GameLog *log, int workers);
+	~Server();
+	void runStdin();
+	bool runSocket(const char *path);
+};
+
+#endif
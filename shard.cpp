@@ -0,0 +1,363 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <map>
+#include <deque>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
+
+/*
+ * Sharded analysis: splits a position file into shards and has worker
+ * processes search them, each over a pair of pipes, then merges the
+ * results into one output in the order of the position file.
+ *
+ *   shard --positions file --output file [--checkpoint file] [--workers N]
+ *         [--shard-size K] [--args "batch --depth 12 ..."]
+ *         [--command template]...
+ *
+ * A worker is started as "<template> <args>" by /bin/sh, so a template of
+ * "ssh host /path/to/Eeyore" runs it on another machine; the default is
+ * ./Eeyore. Each --command starts one worker (or N with --workers); without
+ * any, N local workers are started, one per core by default. Workers speak
+ * the engine's batch mode.
+ *
+ * Every finished shard is added to the checkpoint file (output.ckpt unless
+ * given) before the next is handed out, so a run that is stopped or loses
+ * its workers can be started again with the same arguments and only
+ * searches the shards still missing. Each output line is the position as
+ * it was given, then "; <move> <score> <depth> <nodes>", so the output also
+ * serves as a position file for bench.
+ */
+
+struct Shard
+{
+	int number;
+	int first, end;
+};
+
+/**
+ * Everything the worker threads share.
+ */
+struct Coordinator
+{
+	std::vector<std::string> positions;
+	std::deque<Shard> todo;
+	// Result lines of the finished shards by shard number, position by
+	// position
+	std::map<int, std::vector<std::string> > done;
+	FILE *checkpoint;
+	int shardSize;
+	std::mutex lock;
+};
+
+/**
+ * A worker process and the ends of its pipes.
+ */
+struct Worker
+{
+	std::string command;
+	pid_t pid;
+	FILE *in, *out;
+};
+
+/*
+ * The position part of a position file line: everything before any ';'
+ * comment, without surrounding blanks. Empty if the line holds no position.
+ */
+static std::string positionText(const char *line) {
+	std::string text(line);
+	size_t end = text.find_first_of(";\r\n");
+	if (end != std::string::npos) text.erase(end);
+	size_t first = text.find_first_not_of(" \t");
+	if (first == std::string::npos) return "";
+	text.erase(0, first);
+	text.erase(text.find_last_not_of(" \t") + 1);
+	// 64 squares and the side to move at the least
+	return (text.size() < 65) ? "" : text;
+}
+
+/*
+ * Starts a command under /bin/sh with pipes to its standard input and from
+ * its standard output. Returns false if it cannot be started. Workers are
+ * started from several threads at once, so the pipes are made close on
+ * exec: otherwise a worker forked meanwhile would inherit this one's input
+ * and keep it from ever seeing the end of it. dup2 clears the flag on the
+ * child's own standard input and output.
+ */
+static bool startWorker(Worker *worker) {
+	int toChild[2], fromChild[2];
+	if (pipe2(toChild, O_CLOEXEC) != 0) return false;
+	if (pipe2(fromChild, O_CLOEXEC) != 0) {
+		close(toChild[0]);
+		close(toChild[1]);
+		return false;
+	}
+	pid_t pid = fork();
+	if (pid < 0) {
+		close(toChild[0]);
+		close(toChild[1]);
+		close(fromChild[0]);
+		close(fromChild[1]);
+		return false;
+	}
+	if (pid == 0) {
+		dup2(toChild[0], STDIN_FILENO);
+		dup2(fromChild[1], STDOUT_FILENO);
+		close(toChild[0]);
+		close(toChild[1]);
+		close(fromChild[0]);
+		close(fromChild[1]);
+		execl("/bin/sh", "sh", "-c", worker->command.c_str(), (char *) NULL);
+		_exit(127);
+	}
+	close(toChild[0]);
+	close(fromChild[1]);
+	worker->pid = pid;
+	worker->in = fdopen(toChild[1], "w");
+	worker->out = fdopen(fromChild[0], "r");
+	return true;
+}
+
+/*
+ * Sends one shard to a worker and reads back a result for each position.
+ * Positions are sent as they are answered, a few ahead, so neither pipe
+ * fills up however big the shard. Returns false if the worker goes away
+ * or answers out of turn.
+ */
+static bool searchShard(Coordinator *c, Worker *worker, const Shard &shard, std::vector<std::string> *results) {
+	const int AHEAD = 8;
+	int sent = shard.first;
+	char line[1024];
+	for (int i = shard.first; i < shard.end; i++) {
+		for (; sent < shard.end && sent < i + AHEAD; sent++) {
+			if (fprintf(worker->in, "%d %s\n", sent, c->positions[sent].c_str()) < 0) return false;
+		}
+		if (fflush(worker->in) != 0) return false;
+		if (fgets(line, sizeof(line), worker->out) == NULL) return false;
+		int id;
+		char move[16];
+		int score, depth;
+		long nodes;
+		if (sscanf(line, "%d %15s %d %d %ld", &id, move, &score, &depth, &nodes) != 5 || id != i) {
+			fprintf(stderr, "worker \"%s\" answered %s", worker->command.c_str(), line);
+			return false;
+		}
+		char result[64];
+		snprintf(result, sizeof(result), "%s %d %d %ld", move, score, depth, nodes);
+		results->push_back(result);
+	}
+	return true;
+}
+
+/*
+ * One thread per worker: takes shards until none are left, recording each
+ * in the checkpoint as it finishes. A shard the worker fails on goes back
+ * for another worker, and this one is given up on.
+ */
+static void runWorker(Coordinator *c, Worker *worker) {
+	if (!startWorker(worker)) {
+		fprintf(stderr, "cannot start worker \"%s\"\n", worker->command.c_str());
+		return;
+	}
+	while (true) {
+		Shard shard;
+		{
+			std::lock_guard<std::mutex> guard(c->lock);
+			if (c->todo.empty()) break;
+			shard = c->todo.front();
+			c->todo.pop_front();
+		}
+		std::vector<std::string> results;
+		bool ok = searchShard(c, worker, shard, &results);
+		std::lock_guard<std::mutex> guard(c->lock);
+		if (!ok) {
+			fprintf(stderr, "worker \"%s\" failed on shard %d\n", worker->command.c_str(), shard.number);
+			c->todo.push_back(shard);
+			break;
+		}
+		// The results first and the shard's line last, so a shard only
+		// counts as done once all of it is in the file
+		for (size_t i = 0; i < results.size(); i++)
+			fprintf(c->checkpoint, "%d %d %s\n", shard.number, shard.first + (int) i, results[i].c_str());
+		fprintf(c->checkpoint, "%d done\n", shard.number);
+		fflush(c->checkpoint);
+		fsync(fileno(c->checkpoint));
+		c->done[shard.number] = results;
+		fprintf(stderr, "shard %d done (%d of %d)\n", shard.number, (int) c->done.size(),
+			(int) ((c->positions.size() + c->shardSize - 1) / c->shardSize));
+	}
+	// The end of its input tells the worker to finish
+	fclose(worker->in);
+	fclose(worker->out);
+	waitpid(worker->pid, NULL, 0);
+}
+
+/*
+ * Reads back the finished shards of an earlier run with the same positions
+ * and shard size. Lines of a shard that was cut off are ignored. Returns
+ * false if the checkpoint belongs to a different run.
+ */
+static bool loadCheckpoint(Coordinator *c, const char *file) {
+	FILE *in = fopen(file, "r");
+	if (in == NULL) return true;
+	char line[1024];
+	int count = -1, size = -1;
+	if (fgets(line, sizeof(line), in) == NULL || sscanf(line, "shards of %d positions, %d each", &count, &size) != 2 ||
+		count != (int) c->positions.size() || size != c->shardSize) {
+		fclose(in);
+		return false;
+	}
+	std::map<int, std::vector<std::string> > partial;
+	while (fgets(line, sizeof(line), in) != NULL) {
+		if (line[0] == '\0' || line[strlen(line) - 1] != '\n') break;
+		line[strlen(line) - 1] = '\0';
+		int number, index, n = 0;
+		if (sscanf(line, "%d done%n", &number, &n) == 1 && n > 0 && line[n] == '\0') {
+			std::vector<std::string> &results = partial[number];
+			int expected = std::min(c->shardSize, (int) c->positions.size() - number*c->shardSize);
+			if ((int) results.size() == expected) c->done[number] = results;
+		}
+		else if (sscanf(line, "%d %d %n", &number, &index, &n) == 2 && n > 0) {
+			std::vector<std::string> &results = partial[number];
+			if (index == number*c->shardSize + (int) results.size()) results.push_back(line + n);
+		}
+	}
+	fclose(in);
+	return true;
+}
+
+/*
+ * Starts the checkpoint file over with just the finished shards, so a line
+ * cut off by an earlier crash cannot run into the ones added after it.
+ */
+static bool rewriteCheckpoint(Coordinator *c, const char *file) {
+	std::string temp = std::string(file) + ".tmp";
+	FILE *out = fopen(temp.c_str(), "w");
+	if (out == NULL) return false;
+	fprintf(out, "shards of %d positions, %d each\n", (int) c->positions.size(), c->shardSize);
+	std::map<int, std::vector<std::string> >::iterator it;
+	for (it = c->done.begin(); it != c->done.end(); ++it) {
+		for (size_t i = 0; i < it->second.size(); i++)
+			fprintf(out, "%d %d %s\n", it->first, it->first*c->shardSize + (int) i, it->second[i].c_str());
+		fprintf(out, "%d done\n", it->first);
+	}
+	bool ok = fflush(out) == 0 && fsync(fileno(out)) == 0;
+	ok = (fclose(out) == 0) && ok;
+	if (!ok || rename(temp.c_str(), file) != 0) return false;
+	c->checkpoint = fopen(file, "a");
+	return c->checkpoint != NULL;
+}
+
+static void usage(const char *name) {
+	fprintf(stderr, "usage: %s --positions file --output file [--checkpoint file] [--workers N]\n"
+		"    [--shard-size K] [--args \"batch --depth D ...\"] [--command template]...\n", name);
+	exit(-1);
+}
+
+int main(int argc, char *argv[]) {
+	const char *positionFile = NULL, *outputFile = NULL, *checkpointFile = NULL;
+	int numWorkers = 0, shardSize = 64;
+	std::string args = "batch --depth 10";
+	std::vector<std::string> commands;
+	for (int i = 1; i < argc; i += 2) {
+		if (i + 1 >= argc) usage(argv[0]);
+		if (!strcmp(argv[i], "--positions")) positionFile = argv[i + 1];
+		else if (!strcmp(argv[i], "--output")) outputFile = argv[i + 1];
+		else if (!strcmp(argv[i], "--checkpoint")) checkpointFile = argv[i + 1];
+		else if (!strcmp(argv[i], "--workers")) numWorkers = atoi(argv[i + 1]);
+		else if (!strcmp(argv[i], "--shard-size")) shardSize = atoi(argv[i + 1]);
+		else if (!strcmp(argv[i], "--args")) args = argv[i + 1];
+		else if (!strcmp(argv[i], "--command")) commands.push_back(argv[i + 1]);
+		else usage(argv[0]);
+	}
+	if (positionFile == NULL || outputFile == NULL || shardSize < 1) usage(argv[0]);
+	std::string defaultCheckpoint = std::string(outputFile) + ".ckpt";
+	if (checkpointFile == NULL) checkpointFile = defaultCheckpoint.c_str();
+	// A worker that goes away must not take the coordinator with it
+	signal(SIGPIPE, SIG_IGN);
+
+	Coordinator c;
+	c.shardSize = shardSize;
+	c.checkpoint = NULL;
+	FILE *in = fopen(positionFile, "r");
+	if (in == NULL) {
+		fprintf(stderr, "cannot open %s\n", positionFile);
+		return 1;
+	}
+	char line[1024];
+	while (fgets(line, sizeof(line), in) != NULL) {
+		std::string text = positionText(line);
+		if (!text.empty()) c.positions.push_back(text);
+	}
+	fclose(in);
+	if (c.positions.empty()) {
+		fprintf(stderr, "no positions in %s\n", positionFile);
+		return 1;
+	}
+
+	if (!loadCheckpoint(&c, checkpointFile)) {
+		fprintf(stderr, "%s is the checkpoint of a different run\n", checkpointFile);
+		return 1;
+	}
+	if (!rewriteCheckpoint(&c, checkpointFile)) {
+		fprintf(stderr, "cannot write %s\n", checkpointFile);
+		return 1;
+	}
+	int numShards = (c.positions.size() + shardSize - 1) / shardSize;
+	for (int s = 0; s < numShards; s++) {
+		if (c.done.count(s)) continue;
+		Shard shard = {s, s*shardSize, std::min((s + 1)*shardSize, (int) c.positions.size())};
+		c.todo.push_back(shard);
+	}
+	if (!c.done.empty()) fprintf(stderr, "resuming: %d of %d shards already done\n", (int) c.done.size(), numShards);
+
+	if (commands.empty()) {
+		commands.push_back("./Eeyore");
+		if (numWorkers < 1) numWorkers = std::thread::hardware_concurrency();
+	}
+	if (numWorkers < 1) numWorkers = 1;
+	std::vector<Worker> workers;
+	for (size_t i = 0; i < commands.size(); i++) {
+		for (int n = 0; n < numWorkers; n++) {
+			Worker worker;
+			worker.command = commands[i] + " " + args;
+			workers.push_back(worker);
+		}
+	}
+	std::vector<std::thread> threads;
+	for (size_t i = 0; i < workers.size() && !c.todo.empty(); i++)
+		threads.push_back(std::thread(runWorker, &c, &workers[i]));
+	for (size_t i = 0; i < threads.size(); i++) threads[i].join();
+	fclose(c.checkpoint);
+
+	if ((int) c.done.size() < numShards) {
+		fprintf(stderr, "%d of %d shards are still to do; run again to resume\n", numShards - (int) c.done.size(), numShards);
+		return 1;
+	}
+
+	// Every shard is done, so merge them in the order of the positions
+	std::string temp = std::string(outputFile) + ".tmp";
+	FILE *out = fopen(temp.c_str(), "w");
+	if (out == NULL) {
+		fprintf(stderr, "cannot write %s\n", outputFile);
+		return 1;
+	}
+	std::map<int, std::vector<std::string> >::iterator it;
+	for (it = c.done.begin(); it != c.done.end(); ++it) {
+		for (size_t i = 0; i < it->second.size(); i++)
+			fprintf(out, "%s; %s\n", c.positions[it->first*shardSize + i].c_str(), it->second[i].c_str());
+	}
+	if (fclose(out) != 0 || rename(temp.c_str(), outputFile) != 0) {
+		fprintf(stderr, "cannot write %s\n", outputFile);
+		return 1;
+	}
+	fprintf(stderr, "%d positions written to %s\n", (int) c.positions.size(), outputFile);
+	return 0;
+}
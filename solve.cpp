@@ -0,0 +1,222 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <vector>
+#include "solver.h"
+#include "endgame.h"
+#include "playout.h"
+
+/*
+ * Exact solver for boards of other sizes: solves the starting position of
+ * a 4x4 or 6x6 board, whose perfect play scores are known, or a number of
+ * seeded random positions with E empty squares on any size.
+ *
+ *   solve [--size N] [--empties E] [--count C] [--seed S] [--table bits]
+ *         [--threads T] [--positions file]
+ *
+ * The size is 4, 6, 8 or 10 (4 by default). Scores are for the side to
+ * move, the final disc difference with empty squares going to the winner.
+ * The 4x4 start takes milliseconds and random 6x6 positions with up to 20
+ * or so empty squares a second or two each; the 6x6 start, with all 32
+ * squares to go, is far beyond this solver in any reasonable time.
+ *
+ * With --threads, 8x8 positions are solved by the parallel endgame solver,
+ * once on one thread and once on T, and the times compared. The positions
+ * are random ones as above, or read from a file, one to a line in the FFO
+ * style: 64 squares of X, O and -, a1 to h8, then X or O for the side to
+ * move. Anything after that on the line is ignored.
+ */
+
+// Perfect play from the start loses by this much for black
+static int knownStartScore(int n) {
+	// 11 to 3 with two squares left empty
+	if (n == 4) return -10;
+	if (n == 6) return -4;
+	return 0;
+}
+
+template <int N>
+static void playRandom(typename Geometry<N>::Word *me, typename Geometry<N>::Word *opp, int empties, Xorshift &rng) {
+	typedef Geometry<N> G;
+	typedef typename G::Word Word;
+	while (true) {
+		*me = G::startMe();
+		*opp = G::startOpp();
+		int passes = 0;
+		while (passes < 2 && N*N - G::popcount(*me | *opp) > empties) {
+			Word moves = G::moves(*me, *opp);
+			if (moves) {
+				for (int k = rng.below(G::popcount(moves)); k > 0; k--) moves &= moves - 1;
+				int sq = G::lowestSquare(moves);
+				Word flips = G::flips(sq, *me, *opp);
+				*me |= flips | G::bit(sq);
+				*opp &= ~flips;
+				passes = 0;
+			}
+			else passes++;
+			Word t = *me;
+			*me = *opp;
+			*opp = t;
+		}
+		if (N*N - G::popcount(*me | *opp) == empties && G::moves(*me, *opp) != 0) return;
+	}
+}
+
+template <int N>
+static int run(int empties, int count, uint64_t seed, int tableBits) {
+	typedef Geometry<N> G;
+	typename G::Word me, opp;
+	Xorshift rng(seed);
+	bool start = empties < 0;
+	if (start) count = 1;
+	long nodes = 0;
+	int wrong = 0;
+	std::chrono::steady_clock::time_point began = std::chrono::steady_clock::now();
+	for (int i = 0; i < count; i++) {
+		if (start) {
+			me = G::startMe();
+			opp = G::startOpp();
+		}
+		else playRandom<N>(&me, &opp, empties, rng);
+		Solver<N> solver(tableBits);
+		int score;
+		int move = solver.bestMove(me, opp, &score);
+		nodes += solver.nodes;
+		printf("%dx%d %s %d: score %+d, best %c%d", N, N, start ? "start" : "position", i + 1, score,
+			move < 0 ? '-' : 'a' + move % N, move < 0 ? 0 : move / N + 1);
+		if (start && knownStartScore(N) != 0) {
+			printf(" (known %+d)", knownStartScore(N));
+			wrong += score != knownStartScore(N);
+		}
+		printf("\n");
+	}
+	std::chrono::duration<double> spent = std::chrono::steady_clock::now() - began;
+	printf("%ld nodes, %.3f seconds, %.0f nodes/s\n", nodes, spent.count(), nodes / spent.count());
+	return wrong ? 1 : 0;
+}
+
+/*
+ * Reads a position in the FFO style into the bitboards of the side to move
+ * and its opponent.
+ */
+static bool parsePosition(const char *line, uint64_t *me, uint64_t *opp) {
+	uint64_t black = 0, white = 0;
+	int squares = 0;
+	for (; *line && squares < 64; line++) {
+		if (*line == ' ' || *line == '\t') continue;
+		if (strchr("Xxb*", *line)) black |= 1ULL << squares;
+		else if (strchr("Oow", *line)) white |= 1ULL << squares;
+		squares++;
+	}
+	while (*line == ' ' || *line == '\t') line++;
+	if (squares < 64 || !*line) return false;
+	bool blackToMove = strchr("Xxb*", *line) != NULL;
+	*me = blackToMove ? black : white;
+	*opp = blackToMove ? white : black;
+	return true;
+}
+
+/*
+ * Solves each position on one thread and then on the given number, checks
+ * the two agree and reports how much faster the threads were.
+ */
+static int runParallel(const char *file, int empties, int count, uint64_t seed, int tableBits, int threads) {
+	std::vector<uint64_t> mine, theirs;
+	if (file != NULL) {
+		FILE *in = fopen(file, "r");
+		if (in == NULL) {
+			fprintf(stderr, "can't open %s\n", file);
+			return 1;
+		}
+		char line[256];
+		uint64_t me, opp;
+		while (fgets(line, sizeof(line), in) != NULL) {
+			if (parsePosition(line, &me, &opp)) {
+				mine.push_back(me);
+				theirs.push_back(opp);
+			}
+		}
+		fclose(in);
+	}
+	else {
+		Xorshift rng(seed);
+		for (int i = 0; i < count; i++) {
+			Geometry<8>::Word me, opp;
+			playRandom<8>(&me, &opp, empties, rng);
+			mine.push_back(me);
+			theirs.push_back(opp);
+		}
+	}
+
+	printf("%-10s %6s %6s %10s %10s %8s %8s\n", "position", "empty", "score", "1 thread", "threads", "speedup", "extra");
+	double serialTotal = 0, parallelTotal = 0;
+	int wrong = 0;
+	for (unsigned i = 0; i < mine.size(); i++) {
+		double seconds[2];
+		int score[2];
+		long nodes[2];
+		for (int run = 0; run < 2; run++) {
+			EndgameSolver solver(run == 0 ? 1 : threads, tableBits);
+			std::chrono::steady_clock::time_point began = std::chrono::steady_clock::now();
+			score[run] = solver.solve(mine[i], theirs[i]);
+			std::chrono::duration<double> spent = std::chrono::steady_clock::now() - began;
+			seconds[run] = spent.count();
+			nodes[run] = solver.nodes();
+		}
+		serialTotal += seconds[0];
+		parallelTotal += seconds[1];
+		printf("%-10d %6d %+6d %10.3f %10.3f %7.2fx %+7.1f%%", i + 1, 64 - Geometry<8>::popcount(mine[i] | theirs[i]),
+			score[0], seconds[0], seconds[1], seconds[0] / seconds[1], 100.0 * (nodes[1] - nodes[0]) / nodes[0]);
+		if (score[0] != score[1]) {
+			printf(" (%d threads score %+d)", threads, score[1]);
+			wrong++;
+		}
+		printf("\n");
+	}
+	printf("%d threads: %.3f seconds against %.3f on one, %.2fx\n", threads, parallelTotal, serialTotal,
+		serialTotal / parallelTotal);
+	return wrong ? 1 : 0;
+}
+
+static void usage(const char *name) {
+	fprintf(stderr, "usage: %s [--size 4|6|8|10] [--empties E] [--count C] [--seed S] [--table bits]\n"
+		"       [--threads T] [--positions file]\n", name);
+	exit(-1);
+}
+
+int main(int argc, char *argv[]) {
+	int size = 4, empties = -1, count = 10, tableBits = 20, threads = 0;
+	const char *positions = NULL;
+	uint64_t seed = 1;
+	for (int i = 1; i < argc; i += 2) {
+		if (i + 1 >= argc) usage(argv[0]);
+		if (!strcmp(argv[i], "--size")) size = atoi(argv[i + 1]);
+		else if (!strcmp(argv[i], "--empties")) empties = atoi(argv[i + 1]);
+		else if (!strcmp(argv[i], "--count")) count = atoi(argv[i + 1]);
+		else if (!strcmp(argv[i], "--seed")) seed = strtoull(argv[i + 1], NULL, 10);
+		else if (!strcmp(argv[i], "--table")) tableBits = atoi(argv[i + 1]);
+		else if (!strcmp(argv[i], "--threads")) threads = atoi(argv[i + 1]);
+		else if (!strcmp(argv[i], "--positions")) positions = argv[i + 1];
+		else usage(argv[0]);
+	}
+	if (threads > 0 || positions != NULL) {
+		if (positions == NULL && empties < 0) {
+			fprintf(stderr, "give --empties or --positions to solve on threads\n");
+			return 1;
+		}
+		return runParallel(positions, empties, count, seed, tableBits, threads < 1 ? 1 : threads);
+	}
+	if (empties < 0 && size > 6) {
+		fprintf(stderr, "only 4x4 and 6x6 can be solved from the start; give --empties\n");
+		return 1;
+	}
+	switch (size) {
+		case 4: return run<4>(empties, count, seed, tableBits);
+		case 6: return run<6>(empties, count, seed, tableBits);
+		case 8: return run<8>(empties, count, seed, tableBits);
+		case 10: return run<10>(empties, count, seed, tableBits);
+		default: usage(argv[0]);
+	}
+	return 0;
+}
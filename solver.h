@@ -0,0 +1,183 @@
+#ifndef __SOLVER_H__
+#define __SOLVER_H__
+
+#include <vector>
+#include "geometry.h"
+
+/**
+ * Solves positions on an N x N board exactly: the final disc difference
+ * for the side to move with both sides playing perfectly, empty squares
+ * going to the winner. Negascout over the bitboards of Geometry<N>, with a
+ * transposition table and, away from the last few squares, the moves that
+ * leave the opponent fewest replies searched first.
+ */
+template <int N>
+class Solver {
+	typedef Geometry<N> G;
+	typedef typename G::Word Word;
+
+	// One stored result: bounds on the score and the move that did best
+	struct Entry
+	{
+		Word me, opp;
+		int8_t lower, upper;
+		int8_t best;
+	};
+
+	std::vector<Entry> table;
+	Word tableMask;
+
+	// Below this many empty squares, moves are tried in square order and
+	// results are not stored; ordering costs more than it saves there
+	static const int SHALLOW = 7;
+
+	static inline uint64_t hash(Word me, Word opp) {
+		uint64_t h = (uint64_t) me * 0x9E3779B97F4A7C15ULL ^ (uint64_t) opp * 0xC2B2AE3D27D4EB4FULL;
+		h ^= G::high(me) * 0x165667B19E3779F9ULL ^ G::high(opp) * 0x27D4EB2F165667C5ULL;
+		// The products only carry upwards, so mix the high bits back down
+		h ^= h >> 33;
+		h *= 0xFF51AFD7ED558CCDULL;
+		return h ^ (h >> 33);
+	}
+
+	/*
+	 * The score of a finished game, the empty squares going to the winner.
+	 */
+	static inline int finalScore(Word me, Word opp) {
+		int mine = G::popcount(me), theirs = G::popcount(opp);
+		int empty = N*N - mine - theirs;
+		if (mine > theirs) return mine - theirs + empty;
+		if (mine < theirs) return mine - theirs - empty;
+		return 0;
+	}
+
+	int shallow(Word me, Word opp, int alpha, int beta, bool passed) {
+		nodes++;
+		Word moves = G::moves(me, opp);
+		if (moves == 0) {
+			if (passed) return finalScore(me, opp);
+			return -shallow(opp, me, -beta, -alpha, true);
+		}
+		int best = -N*N - 1;
+		for (; moves; moves &= moves - 1) {
+			int sq = G::lowestSquare(moves);
+			Word flips = G::flips(sq, me, opp);
+			int score = -shallow(opp & ~flips, me | flips | G::bit(sq), -beta, -alpha, false);
+			if (score > best) {
+				best = score;
+				if (score > alpha) alpha = score;
+				if (alpha >= beta) break;
+			}
+		}
+		return best;
+	}
+
+	int search(Word me, Word opp, int alpha, int beta, bool passed) {
+		int empty = N*N - G::popcount(me | opp);
+		if (empty < SHALLOW) return shallow(me, opp, alpha, beta, passed);
+		nodes++;
+		Word moves = G::moves(me, opp);
+		if (moves == 0) {
+			if (passed) return finalScore(me, opp);
+			return -search(opp, me, -beta, -alpha, true);
+		}
+
+		Entry *entry = &table[hash(me, opp) & tableMask];
+		int hashMove = -1;
+		if (entry->me == me && entry->opp == opp) {
+			if (entry->lower >= beta) return entry->lower;
+			if (entry->upper <= alpha) return entry->upper;
+			if (entry->lower == entry->upper) return entry->lower;
+			if (entry->lower > alpha) alpha = entry->lower;
+			if (entry->upper < beta) beta = entry->upper;
+			hashMove = entry->best;
+		}
+
+		// Fastest first: the fewer replies a move leaves, the sooner, a reply
+		// on a corner counting double and a move there being worth a few
+		int list[N*N], replies[N*N], numMoves = 0;
+		for (; moves; moves &= moves - 1) {
+			int sq = G::lowestSquare(moves);
+			Word flips = G::flips(sq, me, opp);
+			Word after = G::moves(opp & ~flips, me | flips | G::bit(sq));
+			int count = 2*(G::popcount(after) + G::popcount(after & G::CORNERS)) - ((G::bit(sq) & G::CORNERS) ? 3 : 0);
+			if (sq == hashMove) count = -1000;
+			int j = numMoves++;
+			for (; j > 0 && replies[j - 1] > count; j--) {
+				list[j] = list[j - 1];
+				replies[j] = replies[j - 1];
+			}
+			list[j] = sq;
+			replies[j] = count;
+		}
+
+		int alphaOrig = alpha, best = -N*N - 1, bestMove = list[0];
+		for (int k = 0; k < numMoves; k++) {
+			int sq = list[k];
+			Word flips = G::flips(sq, me, opp);
+			Word nextMe = opp & ~flips, nextOpp = me | flips | G::bit(sq);
+			int score;
+			if (k == 0) score = -search(nextMe, nextOpp, -beta, -alpha, false);
+			else {
+				score = -search(nextMe, nextOpp, -alpha - 1, -alpha, false);
+				if (score > alpha && score < beta) score = -search(nextMe, nextOpp, -beta, -score, false);
+			}
+			if (score > best) {
+				best = score;
+				bestMove = sq;
+				if (score > alpha) alpha = score;
+				if (alpha >= beta) break;
+			}
+		}
+
+		entry->me = me;
+		entry->opp = opp;
+		entry->lower = (best > alphaOrig) ? best : -N*N;
+		entry->upper = (best < beta) ? best : N*N;
+		entry->best = bestMove;
+		return best;
+	}
+
+public:
+	long nodes;
+
+	// A table of 2 to the tableBits entries
+	Solver(int tableBits = 20) : table((size_t) 1 << tableBits) {
+		tableMask = ((Word) 1 << tableBits) - 1;
+		nodes = 0;
+	}
+
+	/*
+	 * The exact score of the position for the player owning me, or if it is
+	 * outside the window alpha to beta, a bound on it on that side.
+	 */
+	int solve(Word me, Word opp, int alpha = -N*N, int beta = N*N) {
+		return search(me, opp, alpha, beta, false);
+	}
+
+	/*
+	 * The best move for the player owning me, or -1 to pass; the exact
+	 * score is put in score.
+	 */
+	int bestMove(Word me, Word opp, int *score) {
+		Word moves = G::moves(me, opp);
+		*score = solve(me, opp);
+		if (moves == 0) return -1;
+		// Searched deeply enough to be stored, the table knows the move
+		Entry *entry = &table[hash(me, opp) & tableMask];
+		if (entry->me == me && entry->opp == opp) return entry->best;
+		int bestSquare = -1, best = -N*N - 1;
+		for (; moves; moves &= moves - 1) {
+			int sq = G::lowestSquare(moves);
+			Word flips = G::flips(sq, me, opp);
+			int s = -solve(opp & ~flips, me | flips | G::bit(sq));
+			if (s > best) {
+				best = s;
+				bestSquare = sq;
+			}
+		}
+		return bestSquare;
+	}
+};
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef __SYMMETRY_H__
+#define __SYMMETRY_H__
+
+#include <cstdint>
+
+/*
+ * The eight symmetries of the board, as bitboard transforms. Symmetry s
+ * applies up to three basic ones in turn: with bit 0 set it mirrors the
+ * board left to right, with bit 1 it flips it top to bottom, and with bit 2
+ * it then transposes it about the a1-h8 diagonal. Symmetry 0 leaves the
+ * board as it is. The same numbering works for squares, so a move found on
+ * a transformed board can be mapped back with the inverse symmetry.
+ */
+
+#define NUM_SYMMETRIES 8
+
+/*
+ * Reverses the rows: a1 goes to a8.
+ */
+inline uint64_t flipVertical(uint64_t b) {
+	return __builtin_bswap64(b);
+}
+
+/*
+ * Reverses the columns: a1 goes to h1.
+ */
+inline uint64_t mirrorHorizontal(uint64_t b) {
+	b = ((b >> 1) & 0x5555555555555555ULL) | ((b & 0x5555555555555555ULL) << 1);
+	b = ((b >> 2) & 0x3333333333333333ULL) | ((b & 0x3333333333333333ULL) << 2);
+	b = ((b >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((b & 0x0F0F0F0F0F0F0F0FULL) << 4);
+	return b;
+}
+
+/*
+ * Swaps rows and columns: h1 goes to a8. Three rounds of swapping blocks
+ * across the diagonal, 4x4, then 2x2, then single squares.
+ */
+inline uint64_t flipDiagonal(uint64_t b) {
+	uint64_t t;
+	t = 0x0F0F0F0F00000000ULL & (b ^ (b << 28));
+	b ^= t ^ (t >> 28);
+	t = 0x3333000033330000ULL & (b ^ (b << 14));
+	b ^= t ^ (t >> 14);
+	t = 0x5500550055005500ULL & (b ^ (b << 7));
+	b ^= t ^ (t >> 7);
+	return b;
+}
+
+inline uint64_t transform(uint64_t b, int s) {
+	if (s & 1) b = mirrorHorizontal(b);
+	if (s & 2) b = flipVertical(b);
+	if (s & 4) b = flipDiagonal(b);
+	return b;
+}
+
+/*
+ * Where symmetry s takes square sq.
+ */
+inline int transformSquare(int sq, int s) {
+	int x = sq & 7, y = sq >> 3;
+	if (s & 1) x = 7 - x;
+	if (s & 2) y = 7 - y;
+	if (s & 4) {
+		int t = x;
+		x = y;
+		y = t;
+	}
+	return x + 8*y;
+}
+
+/*
+ * The symmetry that undoes s. The flips undo themselves, but undoing them
+ * after a transpose means flipping the other way.
+ */
+inline int inverseSymmetry(int s) {
+	if (!(s & 4)) return s;
+	return 4 | ((s & 1) << 1) | ((s >> 1) & 1);
+}
+
+#endif
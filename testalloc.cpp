@@ -0,0 +1,135 @@
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <atomic>
+#include <chrono>
+#include "common.h"
+#include "player.h"
+#include "board.h"
+
+// Counts every call to the global operator new while counting is switched
+// on, from any thread, as the endgame solver searches on its own
+static std::atomic<bool> counting(false);
+static std::atomic<long> allocations(0);
+
+void *operator new(std::size_t size) {
+    if (counting) allocations++;
+    void *p = malloc(size == 0 ? 1 : size);
+    if (p == NULL) throw std::bad_alloc();
+    return p;
+}
+
+void *operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+// Kept out of line so the compiler does not pair malloc and free itself
+__attribute__((noinline)) static void release(void *p) {
+    free(p);
+}
+
+void operator delete(void *p) noexcept {
+    release(p);
+}
+
+void operator delete[](void *p) noexcept {
+    release(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+    release(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept {
+    release(p);
+}
+
+// How the players are asked for their moves
+enum Mode {
+    FIXED_DEPTH,    // doMove without a clock
+    CLOCKED,        // doMove with the clock running down
+    LIMITS          // playMove to a fixed depth
+};
+
+// Each side's clock in the clocked games, long enough for the searches to
+// go deep and the end to be solved
+#define CLOCK_MS 10000
+
+/*
+ * Plays a whole game of the engine against itself and checks that no move,
+ * from entry to the returned move, allocates on the heap. Returns how many
+ * moves were searched, or -1 if one allocated.
+ */
+static int playGame(const char *name, Player *black, Player *white, Mode mode) {
+    Move *last = NULL;
+    Move lastCopy(-1, -1);
+    Player *toMove = black;
+    long msLeft[2] = {CLOCK_MS, CLOCK_MS};
+    SearchLimits limits;
+    limits.depth = 6;
+    int passes = 0, plies = 0;
+
+    while (passes < 2) {
+        int side = (toMove == black) ? 0 : 1;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        Move *move;
+        counting = true;
+        if (mode == FIXED_DEPTH) move = toMove->doMove(last, -1);
+        else if (mode == CLOCKED) move = toMove->doMove(last, msLeft[side]);
+        else move = toMove->playMove(last, limits);
+        counting = false;
+        if (allocations != 0) {
+            printf("%s: allocated %ld times during move %d\n", name, allocations.load(), plies);
+            return -1;
+        }
+        msLeft[side] -= std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        // Never hand a player a clock that has run out; the moves are
+        // still searched, just in a hurry
+        if (msLeft[side] < 1) msLeft[side] = 1;
+        // The returned move belongs to the player, so hand the other player
+        // a copy of it
+        if (move == NULL) {
+            passes++;
+            last = NULL;
+        }
+        else {
+            passes = 0;
+            lastCopy.setX(move->getX());
+            lastCopy.setY(move->getY());
+            last = &lastCopy;
+        }
+        toMove = (toMove == black) ? white : black;
+        plies++;
+    }
+    return plies;
+}
+
+// Plays games of the engine against itself in each way it can be asked for
+// moves: without a clock, under the clock on one thread, under the clock
+// with the endgame solved on two threads (so from 20 empty squares on), and
+// to fixed limits as the server and protocol do. Fails if any move
+// allocates.
+int main(int argc, char *argv[]) {
+    const char *names[4] = {"fixed depth", "clocked", "clocked, 2 endgame threads", "fixed limits"};
+    Mode modes[4] = {FIXED_DEPTH, CLOCKED, CLOCKED, LIMITS};
+    int total = 0;
+    for (int game = 0; game < 4; game++) {
+        // Startup is allowed to allocate
+        Player *black = new Player(BLACK);
+        Player *white = new Player(WHITE);
+        if (game == 2) {
+            black->useEndgameThreads(2);
+            white->useEndgameThreads(2);
+        }
+        int plies = playGame(names[game], black, white, modes[game]);
+        delete black;
+        delete white;
+        if (plies < 0) return 1;
+        printf("%s: no allocations in %d searched moves\n", names[game], plies);
+        total += plies;
+    }
+
+    printf("No allocations in %d searched moves\n", total);
+    return 0;
+}
@@ -0,0 +1,76 @@
+#include "timeman.h"
+
+// Kept off every budget for the time the move takes to reach the referee
+static const long SAFETY_MS = 500;
+// The solve gets as much time as this many middle game moves
+static const int SOLVE_SHARES = 8;
+// A score this much below the last depth's, about a corner, means trouble
+static const int SCORE_DROP = 30;
+// Never less than this, so that even a nearly flagged clock finds a move
+static const long MIN_MS = 10;
+
+TimeManager::TimeManager() {
+	startMove(0, 60);
+}
+
+/*
+ * Sets the budgets of the move about to be searched, with msLeft on our
+ * clock and the given number of empty squares on the board.
+ */
+void TimeManager::startMove(long msLeft, int empties) {
+	long usable = msLeft - SAFETY_MS;
+	if (usable < 0) usable = 0;
+	if (empties <= SOLVE_EMPTIES) {
+		// The solve, once it finishes, makes the rest of the game quick; if
+		// it does not, half the clock is still there for the next try
+		hard = usable / 2;
+		soft = usable / 3;
+	}
+	else {
+		// Our moves until the solve, this one included, and the solve
+		int movesLeft = (empties - SOLVE_EMPTIES + 1) / 2;
+		long share = usable / (movesLeft + SOLVE_SHARES);
+		if (empties > 44) soft = share / 2;
+		else if (empties > 26) soft = share * 5 / 4;
+		else soft = share;
+		hard = soft * 3;
+		if (hard > usable / 4) hard = usable / 4;
+	}
+	if (soft > hard) soft = hard;
+	if (hard < MIN_MS) hard = MIN_MS;
+	if (soft < MIN_MS) soft = MIN_MS;
+	budget = soft;
+	lastBest = -1;
+	lastScore = 0;
+	lastElapsed = 0;
+	lastIteration = 0;
+	previousIteration = 0;
+}
+
+/*
+ * Called after each depth finishes, elapsed ms into the move, with the best
+ * move and score it found. Returns whether to stop rather than start the
+ * next depth, which it does when that depth is not expected to finish
+ * within the budget. The hard limit is only there for when the expectation
+ * is wrong.
+ */
+bool TimeManager::iterationDone(int depth, int best, int score, long elapsed) {
+	previousIteration = lastIteration;
+	lastIteration = elapsed - lastElapsed;
+	lastElapsed = elapsed;
+	if (depth > 1) {
+		if (best != lastBest) budget += soft / 2;
+		if (score < lastScore - SCORE_DROP) budget += soft / 2;
+		if (budget > hard) budget = hard;
+	}
+	lastBest = best;
+	lastScore = score;
+	// Each depth takes a few times as long as the one before
+	long growth = 4;
+	if (previousIteration > 0) {
+		growth = lastIteration / previousIteration;
+		if (growth < 2) growth = 2;
+		if (growth > 8) growth = 8;
+	}
+	return elapsed + lastIteration * growth > budget;
+}
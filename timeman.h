@@ -0,0 +1,39 @@
+#ifndef __TIMEMAN_H__
+#define __TIMEMAN_H__
+
+// From this many empty squares on the game is solved exactly; the time
+// banked through the middle game is spent there
+#define SOLVE_EMPTIES 20
+
+/**
+ * Shares the clock out over the moves of a game. Each move gets a soft
+ * budget, after which no new depth is started, and a hard limit, at which
+ * the search is cut off. The budgets follow the phase of the game: the
+ * opening, where little is decided yet and shallow searches do well, gets
+ * less than the middle game, where the result is decided, and enough is
+ * kept back for the exact solve at SOLVE_EMPTIES. While a move is being
+ * searched, the soft budget is stretched towards the hard limit whenever
+ * the best move changes between depths or the score drops, as the move is
+ * not settled yet.
+ */
+class TimeManager {
+	long soft;
+	long hard;
+	// The soft budget with the extensions so far
+	long budget;
+	// What the depth before found, and how long it and the one before took
+	int lastBest;
+	int lastScore;
+	long lastElapsed;
+	long lastIteration;
+	long previousIteration;
+
+public:
+	TimeManager();
+	void startMove(long msLeft, int empties);
+	bool iterationDone(int depth, int best, int score, long elapsed);
+	long softLimit() { return soft; }
+	long hardLimit() { return hard; }
+};
+
+#endif
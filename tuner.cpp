@@ -0,0 +1,302 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "common.h"
+#include "eval.h"
+#include "positions.h"
+
+/*
+ * Offline tuner for the evaluation weights. It works in two steps:
+ *
+ *   tuner extract positions features.bin [--text] [--label result|score]
+ *       Computes the evaluation features of every labelled position once
+ *       and streams them out as small fixed size records.
+ *   tuner fit features.bin weights.bin [--threads N] [--epochs N]
+ *       [--batch N] [--rate R] [--scale S]
+ *       Maps the feature file and fits the weights of every phase by
+ *       mini-batch gradient descent, split over several threads, then writes
+ *       the weight file the engine loads with --weights.
+ *
+ * Positions are read from binary PositionRecord files, or with --text from
+ * lines of 64 squares ('b', 'w' or '-', square x + y*8 first), the side to
+ * move ('b' or 'w') and the label for the side to move.
+ */
+
+/**
+ * One position reduced to what the fit needs. The target is the label in
+ * the position's own units (discs); it is scaled when fitting.
+ */
+struct FeatureRecord
+{
+	int16_t features[NUM_FEATURES];
+	int16_t target;
+	uint8_t phase;
+	uint8_t unused;
+};
+
+static const char FEATURES_MAGIC[8] = {'E', 'E', 'Y', 'F', 'E', 'A', 'T', 'S'};
+
+struct FeatureHeader
+{
+	char magic[8];
+	uint32_t numFeatures;
+	uint32_t recordSize;
+};
+
+/*
+ * Reads one text position, returning false at the end of the file.
+ */
+static bool readTextPosition(FILE *in, PositionRecord *pos) {
+	char squares[65], side[2];
+	int label;
+	if (fscanf(in, "%64s %1s %d", squares, side, &label) != 3) return false;
+	pos->black = pos->white = 0;
+	for (int i = 0; i < 64 && squares[i]; i++) {
+		if (squares[i] == 'b') pos->black |= 1ULL << i;
+		else if (squares[i] == 'w') pos->white |= 1ULL << i;
+	}
+	pos->toMove = (side[0] == 'b') ? BLACK : WHITE;
+	pos->result = label;
+	pos->score = label;
+	return true;
+}
+
+static int extract(const char *inFile, const char *outFile, bool text, bool useScore) {
+	FILE *in = fopen(inFile, text ? "r" : "rb");
+	if (in == NULL) {
+		fprintf(stderr, "cannot open %s\n", inFile);
+		return 1;
+	}
+	FILE *out = fopen(outFile, "wb");
+	if (out == NULL) {
+		fprintf(stderr, "cannot open %s\n", outFile);
+		return 1;
+	}
+	FeatureHeader header;
+	memcpy(header.magic, FEATURES_MAGIC, 8);
+	header.numFeatures = NUM_FEATURES;
+	header.recordSize = sizeof(FeatureRecord);
+	fwrite(&header, sizeof(header), 1, out);
+
+	// Positions are converted in blocks so that reading, working and writing
+	// each go through big buffers
+	const int BLOCK = 1 << 16;
+	std::vector<PositionRecord> positions(BLOCK);
+	std::vector<FeatureRecord> records(BLOCK);
+	long total = 0, skipped = 0;
+	while (true) {
+		int n = 0;
+		if (text) {
+			while (n < BLOCK && readTextPosition(in, &positions[n])) n++;
+		}
+		else n = fread(positions.data(), sizeof(PositionRecord), BLOCK, in);
+		if (n == 0) break;
+
+		int kept = 0;
+		for (int i = 0; i < n; i++) {
+			const PositionRecord &p = positions[i];
+			int label = useScore ? p.score : p.result;
+			if (label == NO_SCORE) {
+				skipped++;
+				continue;
+			}
+			uint64_t me = (p.toMove == BLACK) ? p.black : p.white;
+			uint64_t opp = (p.toMove == BLACK) ? p.white : p.black;
+			int features[NUM_FEATURES];
+			evalFeatures(me, opp, features);
+			FeatureRecord &r = records[kept++];
+			for (int f = 0; f < NUM_FEATURES; f++) r.features[f] = features[f];
+			r.target = label;
+			r.phase = evalPhase(me, opp);
+			r.unused = 0;
+		}
+		fwrite(records.data(), sizeof(FeatureRecord), kept, out);
+		total += kept;
+	}
+	fclose(in);
+	fclose(out);
+	printf("%ld positions written, %ld without a label skipped\n", total, skipped);
+	return 0;
+}
+
+/**
+ * Sums one thread builds up over its share of a mini-batch.
+ */
+struct Gradient
+{
+	double grad[NUM_PHASES][NUM_FEATURES];
+	double loss;
+	long count[NUM_PHASES];
+	void clear() {
+		memset(grad, 0, sizeof(grad));
+		memset(count, 0, sizeof(count));
+		loss = 0;
+	}
+};
+
+/*
+ * Adds up the squared error gradient of records [begin, end).
+ */
+static void gradientOf(const FeatureRecord *records, long begin, long end,
+	const double w[NUM_PHASES][NUM_FEATURES], double scale, Gradient *g) {
+	g->clear();
+	for (long i = begin; i < end; i++) {
+		const FeatureRecord &r = records[i];
+		const double *wp = w[r.phase];
+		double predicted = 0;
+		for (int f = 0; f < NUM_FEATURES; f++) predicted += wp[f] * r.features[f];
+		double error = predicted - r.target * scale;
+		for (int f = 0; f < NUM_FEATURES; f++) g->grad[r.phase][f] += error * r.features[f];
+		g->count[r.phase]++;
+		g->loss += error * error;
+	}
+}
+
+static int fit(const char *inFile, const char *outFile, int threads, int epochs,
+	long batch, double rate, double scale) {
+	int fd = open(inFile, O_RDONLY);
+	struct stat st;
+	if (fd < 0 || fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(FeatureHeader)) {
+		fprintf(stderr, "cannot read %s\n", inFile);
+		return 1;
+	}
+	void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		fprintf(stderr, "cannot map %s\n", inFile);
+		return 1;
+	}
+	const FeatureHeader *header = (const FeatureHeader *) map;
+	if (memcmp(header->magic, FEATURES_MAGIC, 8) != 0 || header->numFeatures != NUM_FEATURES ||
+		header->recordSize != sizeof(FeatureRecord)) {
+		fprintf(stderr, "%s was made for different features\n", inFile);
+		return 1;
+	}
+	// The whole file is read front to back each epoch
+	madvise(map, st.st_size, MADV_SEQUENTIAL);
+	const FeatureRecord *records = (const FeatureRecord *) (header + 1);
+	long n = (st.st_size - sizeof(FeatureHeader)) / sizeof(FeatureRecord);
+	if (n == 0) {
+		fprintf(stderr, "no positions in %s\n", inFile);
+		return 1;
+	}
+
+	// The features are on very different scales (a handful of corners,
+	// dozens of frontier squares), so each step is divided by the mean
+	// square of its feature: gradient descent with a diagonal
+	// preconditioner.
+	double meanSquare[NUM_PHASES][NUM_FEATURES] = {{0}};
+	long phaseCount[NUM_PHASES] = {0};
+	for (long i = 0; i < n; i++) {
+		for (int f = 0; f < NUM_FEATURES; f++)
+			meanSquare[records[i].phase][f] += (double) records[i].features[f] * records[i].features[f];
+		phaseCount[records[i].phase]++;
+	}
+
+	// Start from the weights the engine uses now
+	EvalWeights start;
+	defaultWeights(&start);
+	double w[NUM_PHASES][NUM_FEATURES];
+	for (int p = 0; p < NUM_PHASES; p++) {
+		for (int f = 0; f < NUM_FEATURES; f++) {
+			w[p][f] = start.w[p][f];
+			meanSquare[p][f] = (phaseCount[p] > 0) ? meanSquare[p][f] / phaseCount[p] + 1e-3 : 1;
+		}
+	}
+
+	std::vector<Gradient> parts(threads);
+	std::vector<std::thread> workers;
+	for (int epoch = 0; epoch < epochs; epoch++) {
+		double loss = 0;
+		for (long b = 0; b < n; b += batch) {
+			long end = (b + batch < n) ? b + batch : n;
+			long share = (end - b + threads - 1) / threads;
+			workers.clear();
+			for (int t = 0; t < threads; t++) {
+				long from = b + t * share;
+				long to = (from + share < end) ? from + share : end;
+				if (from > to) from = to;
+				workers.push_back(std::thread(gradientOf, records, from, to, w, scale, &parts[t]));
+			}
+			for (int t = 0; t < threads; t++) workers[t].join();
+
+			Gradient total;
+			total.clear();
+			for (int t = 0; t < threads; t++) {
+				for (int p = 0; p < NUM_PHASES; p++) {
+					for (int f = 0; f < NUM_FEATURES; f++) total.grad[p][f] += parts[t].grad[p][f];
+					total.count[p] += parts[t].count[p];
+				}
+				total.loss += parts[t].loss;
+			}
+			loss += total.loss;
+			for (int p = 0; p < NUM_PHASES; p++) {
+				if (total.count[p] == 0) continue;
+				for (int f = 0; f < NUM_FEATURES; f++)
+					w[p][f] -= rate * total.grad[p][f] / total.count[p] / meanSquare[p][f];
+			}
+		}
+		printf("epoch %d: rms error %.3f discs\n", epoch + 1, sqrt(loss / n) / scale);
+		fflush(stdout);
+	}
+	munmap(map, st.st_size);
+
+	EvalWeights fitted;
+	for (int p = 0; p < NUM_PHASES; p++) {
+		printf("phase %d:", p);
+		for (int f = 0; f < NUM_FEATURES; f++) {
+			fitted.w[p][f] = (int) lround(w[p][f]);
+			printf(" %d", fitted.w[p][f]);
+		}
+		printf("\n");
+	}
+	if (!saveWeights(outFile, &fitted)) {
+		fprintf(stderr, "cannot write %s\n", outFile);
+		return 1;
+	}
+	return 0;
+}
+
+static void usage(const char *name) {
+	fprintf(stderr, "usage: %s extract positions features.bin [--text] [--label result|score]\n", name);
+	fprintf(stderr, "       %s fit features.bin weights.bin [--threads N] [--epochs N] "
+		"[--batch N] [--rate R] [--scale S]\n", name);
+	exit(-1);
+}
+
+int main(int argc, char *argv[]) {
+	if (argc < 4) usage(argv[0]);
+	bool text = false, useScore = false;
+	int threads = std::thread::hardware_concurrency();
+	int epochs = 20;
+	long batch = 1 << 16;
+	double rate = 0.5;
+	// A disc at the end of the game is worth as much as in the hand picked
+	// endgame weights
+	double scale = 40;
+	for (int i = 4; i < argc; i++) {
+		if (!strcmp(argv[i], "--text")) text = true;
+		else if (i + 1 >= argc) usage(argv[0]);
+		else if (!strcmp(argv[i], "--label")) useScore = !strcmp(argv[++i], "score");
+		else if (!strcmp(argv[i], "--threads")) threads = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--epochs")) epochs = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--batch")) batch = atol(argv[++i]);
+		else if (!strcmp(argv[i], "--rate")) rate = atof(argv[++i]);
+		else if (!strcmp(argv[i], "--scale")) scale = atof(argv[++i]);
+		else usage(argv[0]);
+	}
+	if (threads < 1) threads = 1;
+	if (batch < 1) batch = 1;
+
+	if (!strcmp(argv[1], "extract")) return extract(argv[2], argv[3], text, useScore);
+	if (!strcmp(argv[1], "fit")) return fit(argv[2], argv[3], threads, epochs, batch, rate, scale);
+	usage(argv[0]);
+	return 0;
+}
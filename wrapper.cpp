@@ -1,21 +1,138 @@
 #include <iostream>
 #include <cstdlib>
 #include <cstring>
+#include <string>
+#include <cstdio>
 #include "player.h"
+#include "protocol.h"
+#include "server.h"
 using namespace std;
 
-std::stack<int> *Board::moves = new std::stack<int>();
-
 int main(int argc, char *argv[]) {    
-    // Read in side the player is on.
-    if (argc != 2)  {
-        cerr << "usage: " << argv[0] << " side" << endl;
+    // Read in side the player is on, followed by any options.
+    if (argc < 2)  {
+        cerr << "usage: " << argv[0] << " Black|White|server|batch [--cache file] [--cache-size entries] [--weights file] [--log file]\n"
+             << "    [--search negascout|mcts] [--threads n] [--seed n] [--nnue file] [--eval-cache entries]\n"
+             << "    [--lmr on|off] [--futility margin] [--razor margin]\n"
+             << "    [--workers n] [--socket path]   (server only)\n"
+             << "    [--depth d] [--movetime ms] [--nodes n]   (batch, or instead of the clock)" << endl;
         exit(-1);
     }
     Side side = (!strcmp(argv[1], "Black")) ? BLACK : WHITE;
+    // Or host many games at once
+    bool server = !strcmp(argv[1], "server");
+    // Or search the positions a shard coordinator sends
+    bool batch = !strcmp(argv[1], "batch");
+    SearchLimits limits;
+    int workers = std::thread::hardware_concurrency();
+    const char *socketPath = NULL;
+    const char *cacheFile = NULL;
+    int cacheSize = 1 << 20;
+    // A megabyte of evaluations, which fits in L2
+    int evalCacheSize = 1 << 16;
+    const char *weightsFile = NULL;
+    const char *logFile = NULL;
+    const char *networkFile = NULL;
+    EngineOptions options;
+    for (int i = 2; i < argc; i += 2) {
+        if (i + 1 >= argc) {
+            cerr << "missing value for " << argv[i] << endl;
+            exit(-1);
+        }
+        if (!strcmp(argv[i], "--cache")) cacheFile = argv[i + 1];
+        else if (!strcmp(argv[i], "--cache-size")) cacheSize = atoi(argv[i + 1]);
+        // 0 evaluates every leaf afresh
+        else if (!strcmp(argv[i], "--eval-cache")) evalCacheSize = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "--weights")) weightsFile = argv[i + 1];
+        else if (!strcmp(argv[i], "--log")) logFile = argv[i + 1];
+        else if (!strcmp(argv[i], "--search")) options.mcts = !strcmp(argv[i + 1], "mcts");
+        else if (!strcmp(argv[i], "--threads")) options.threads = atoi(argv[i + 1]);
+        // A seed makes the Monte Carlo threads take turns, so their moves
+        // can be reproduced
+        else if (!strcmp(argv[i], "--seed")) {
+            options.seed = strtoull(argv[i + 1], NULL, 10);
+            options.deterministic = options.seed != 0;
+        }
+        else if (!strcmp(argv[i], "--nnue")) networkFile = argv[i + 1];
+        else if (!strcmp(argv[i], "--workers")) workers = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "--socket")) socketPath = argv[i + 1];
+        else if (!strcmp(argv[i], "--depth")) limits.depth = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "--movetime")) limits.movetime = atol(argv[i + 1]);
+        else if (!strcmp(argv[i], "--nodes")) limits.nodes = atol(argv[i + 1]);
+        else if (!strcmp(argv[i], "--lmr")) options.params.lateMoveReductions = strcmp(argv[i + 1], "off");
+        // A margin of 0 switches futility pruning or razoring off
+        else if (!strcmp(argv[i], "--futility")) {
+            options.params.futilityMargin = atoi(argv[i + 1]);
+            options.params.futility = options.params.futilityMargin > 0;
+        }
+        else if (!strcmp(argv[i], "--razor")) {
+            options.params.razorMargin = atoi(argv[i + 1]);
+            options.params.razoring = options.params.razorMargin > 0;
+        }
+        else {
+            cerr << "unknown option " << argv[i] << endl;
+            exit(-1);
+        }
+    }
+
+    // Load the shared data, then initialize player.
+    if (weightsFile != NULL) {
+        EvalWeights *weights = new EvalWeights();
+        if (!loadWeights(weightsFile, weights)) {
+            cerr << "cannot load weights from " << weightsFile << endl;
+            exit(-1);
+        }
+        options.weights = weights;
+    }
+    if (networkFile != NULL) {
+        Network *network = new Network();
+        if (!network->load(networkFile)) {
+            cerr << "cannot load network from " << networkFile << endl;
+            exit(-1);
+        }
+        options.network = network;
+    }
+    SolveCache *cache = NULL;
+    if (cacheFile != NULL) {
+        // Only results of searches at least 6 deep are worth keeping. The
+        // network, when there is one, is what scores the positions.
+        uint64_t evaluator = (options.network != NULL) ? options.network->hash() :
+            weightsHash(options.weights != NULL ? options.weights : standardWeights());
+        cache = new SolveCache(cacheFile, cacheSize, 6, evaluator);
+        cache->load();
+        options.cache = cache;
+    }
+    if (evalCacheSize > 0) options.evalCache = new EvalCache(evalCacheSize);
+    GameLog *log = NULL;
+    if (logFile != NULL) log = new GameLog(logFile);
+
+    if (server) {
+        Server *games = new Server(options, log, workers);
+        if (socketPath == NULL) games->runStdin();
+        else if (!games->runSocket(socketPath)) {
+            cerr << "cannot listen on " << socketPath << endl;
+            exit(-1);
+        }
+        delete games;
+        if (log != NULL) delete log;
+        if (cache != NULL) cache->saveResults();
+        return 0;
+    }
 
-    // Initialize player.
-    Player *player = new Player(side);
+    if (batch) {
+        // Without limits, search as deep as the server does without a clock
+        if (limits.depth <= 0 && limits.movetime <= 0 && limits.nodes <= 0) limits.depth = 8;
+        runBatch(options, limits);
+        if (log != NULL) delete log;
+        if (cache != NULL) cache->saveResults();
+        return 0;
+    }
+
+    Player *player = newPlayer(side, options);
+    if (log != NULL) player->setLog(log);
+    // Only this player plays under the clock, and so solves the endgame on
+    // the threads
+    if (!options.mcts && options.threads > 1) player->useEndgameThreads(options.threads);
 
     // Tell java wrapper that we are done initializing.
     cout << "Init done" << endl;
@@ -23,14 +140,31 @@ int main(int argc, char *argv[]) {
     
     int moveX, moveY, msLeft;    
 
+    // The java wrapper sends the opponent's move and our time left as three
+    // numbers; anything else is the extended protocol
+    std::string line;
+    if (!getline(cin, line)) return 0;
+    if (sscanf(line.c_str(), "%d %d %d", &moveX, &moveY, &msLeft) != 3) {
+        delete player;
+        Protocol protocol(options);
+        protocol.run(line);
+        if (cache != NULL) cache->saveResults();
+        return 0;
+    }
+
     // Get opponent's move and time left for player each turn.
-    while (cin >> moveX >> moveY >> msLeft) {
+    do {
         Move *opponentsMove = NULL;
         if (moveX >= 0 && moveY >= 0) {
             opponentsMove = new Move(moveX, moveY);
         }
-        // Get player's move and output to java wrapper.
-        Move *playersMove = player->doMove(opponentsMove, msLeft);                        
+        // Get player's move and output to java wrapper. Given limits,
+        // search within them rather than by the clock, so the same game
+        // is played the same way every time.
+        Move *playersMove;
+        if (limits.depth > 0 || limits.nodes > 0 || limits.movetime > 0)
+            playersMove = player->playMove(opponentsMove, limits);
+        else playersMove = player->doMove(opponentsMove, msLeft);
         if (playersMove != NULL) {                  
             cout << playersMove->x << " " << playersMove->y << endl;
         } else {
@@ -39,10 +173,15 @@ int main(int argc, char *argv[]) {
         cout.flush();
         cerr.flush();
         
-        // Delete move objects.
+        // Delete move objects. The player's own move belongs to the player.
         if (opponentsMove != NULL) delete opponentsMove;
-        if (playersMove != NULL) delete playersMove; 
-    }
+    } while (cin >> moveX >> moveY >> msLeft);
+
+    // The game is over, so record it and merge what we learned into the
+    // cache file. Deleting the log waits for the game to be written.
+    player->gameOver();
+    if (log != NULL) delete log;
+    if (cache != NULL) cache->saveResults();
 
     return 0;
 }
@@ -0,0 +1,258 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "common.h"
+#include "bitboard.h"
+#include "positions.h"
+
+/*
+ * Imports WTHOR game archives (.wtb) as labelled positions:
+ *
+ *   wthor positions.bin games.wtb... [--threads N]
+ *
+ * Each archive is mapped into memory and its games are replayed by several
+ * threads at once through the bitboard move generator. Every position a
+ * game passes through is written out as a PositionRecord, in the order of
+ * the archives and their games, with the final disc difference of the game
+ * for the side to move as its result. The one position of each game with
+ * as many empty squares as the archive's theoretical score depth also gets
+ * that score; every other score is NO_SCORE.
+ *
+ * A WTHOR file is a 16 byte header, which holds the number of games and
+ * the theoretical score depth, then 68 bytes per game: tournament and
+ * player numbers, black's disc count at the end and with perfect play from
+ * the theoretical depth, and 60 move bytes, 10*row + column counting from
+ * 1, padded with zeros. Passes are not recorded. A game with a move that
+ * is not legal, or any other malformed byte, is skipped as a whole.
+ */
+
+#define WTHOR_HEADER_SIZE 16
+#define WTHOR_GAME_SIZE 68
+// The theoretical score depth archives use if their header gives none
+#define WTHOR_DEFAULT_DEPTH 22
+
+struct ImportStats
+{
+	long games;
+	long corrupt;
+	long positions;
+	long scored;
+	// Games played out whose recorded score differs from the replay
+	long mismatched;
+	void add(const ImportStats &other) {
+		games += other.games;
+		corrupt += other.corrupt;
+		positions += other.positions;
+		scored += other.scored;
+		mismatched += other.mismatched;
+	}
+};
+
+/*
+ * The disc difference for black at the end of a game, the empty squares
+ * going to the winner.
+ */
+static int finalDifference(uint64_t black, uint64_t white) {
+	int b = popcount(black), w = popcount(white);
+	int empty = 64 - b - w;
+	if (b > w) return b - w + empty;
+	if (b < w) return b - w - empty;
+	return 0;
+}
+
+/*
+ * Replays one game record, adding its positions to out. Returns false, and
+ * adds nothing, if the record does not hold a legal game.
+ */
+static bool replayGame(const uint8_t *game, int theoryDepth, std::vector<PositionRecord> &out,
+	ImportStats *stats) {
+	int blackDiscs = game[6], theoretical = game[7];
+	if (blackDiscs > 64 || theoretical > 64) return false;
+	const uint8_t *moves = game + 8;
+	size_t first = out.size();
+	uint64_t black = 0x0000000810000000ULL, white = 0x0000001008000000ULL;
+	Side side = BLACK;
+	int numMoves = 0;
+	long theoryAt = -1;
+	for (; numMoves < 60 && moves[numMoves] != 0; numMoves++) {
+		int code = moves[numMoves];
+		int x = code % 10 - 1, y = code / 10 - 1;
+		if (x < 0 || x > 7 || y < 0 || y > 7) break;
+		int sq = x + 8*y;
+		uint64_t me = (side == BLACK) ? black : white, opp = (side == BLACK) ? white : black;
+		if (!((moveMask(me, opp) >> sq) & 1)) {
+			// Not a move for this side, so it must have had to pass
+			if (moveMask(me, opp) != 0 || !((moveMask(opp, me) >> sq) & 1)) break;
+			side = (side == BLACK) ? WHITE : BLACK;
+			uint64_t t = me;
+			me = opp;
+			opp = t;
+		}
+		PositionRecord pos;
+		pos.black = black;
+		pos.white = white;
+		pos.toMove = side;
+		pos.result = 0;
+		pos.score = NO_SCORE;
+		pos.unused = 0;
+		if (60 - numMoves == theoryDepth) theoryAt = out.size();
+		out.push_back(pos);
+
+		uint64_t flips = flipMask(sq, me, opp);
+		me |= flips | (1ULL << sq);
+		opp &= ~flips;
+		black = (side == BLACK) ? me : opp;
+		white = (side == BLACK) ? opp : me;
+		side = (side == BLACK) ? WHITE : BLACK;
+	}
+	// Stopped early by a bad move, or moves after the padding
+	bool bad = numMoves < 60 && moves[numMoves] != 0;
+	for (int i = numMoves; i < 60 && !bad; i++) bad = moves[i] != 0;
+	if (bad) {
+		out.resize(first);
+		return false;
+	}
+
+	// A game played out is scored by its last board; one stopped early,
+	// by time or resignation, by what the archive says
+	int result = 2*blackDiscs - 64;
+	if (moveMask(black, white) == 0 && moveMask(white, black) == 0) {
+		int replayed = finalDifference(black, white);
+		if (replayed != result) stats->mismatched++;
+		result = replayed;
+	}
+	for (size_t i = first; i < out.size(); i++) out[i].result = (out[i].toMove == BLACK) ? result : -result;
+	if (theoryAt >= 0) {
+		int score = 2*theoretical - 64;
+		out[theoryAt].score = (out[theoryAt].toMove == BLACK) ? score : -score;
+		stats->scored++;
+	}
+	stats->positions += out.size() - first;
+	return true;
+}
+
+/*
+ * One thread's share of a block of games.
+ */
+static void replayGames(const uint8_t *games, long count, int theoryDepth, std::vector<PositionRecord> *out,
+	ImportStats *stats) {
+	out->clear();
+	memset(stats, 0, sizeof(*stats));
+	for (long g = 0; g < count; g++) {
+		stats->games++;
+		if (!replayGame(games + g*WTHOR_GAME_SIZE, theoryDepth, *out, stats)) stats->corrupt++;
+	}
+}
+
+/*
+ * Imports one archive, appending its positions to out. Returns false if
+ * the file cannot be read or is not a WTHOR game archive.
+ */
+static bool importFile(const char *file, FILE *out, int threads, ImportStats *total) {
+	int fd = open(file, O_RDONLY);
+	struct stat st;
+	if (fd < 0 || fstat(fd, &st) != 0 || st.st_size < WTHOR_HEADER_SIZE) {
+		fprintf(stderr, "cannot read %s\n", file);
+		if (fd >= 0) close(fd);
+		return false;
+	}
+	void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		fprintf(stderr, "cannot map %s\n", file);
+		return false;
+	}
+	madvise(map, st.st_size, MADV_SEQUENTIAL);
+	const uint8_t *data = (const uint8_t *) map;
+	// The counts are little endian
+	long numGames = data[4] | (data[5] << 8) | (data[6] << 16) | ((long) data[7] << 24);
+	int boardSize = data[12], theoryDepth = data[14];
+	if (boardSize != 0 && boardSize != 8) {
+		fprintf(stderr, "%s is not an 8x8 game archive\n", file);
+		munmap(map, st.st_size);
+		return false;
+	}
+	if (theoryDepth == 0) theoryDepth = WTHOR_DEFAULT_DEPTH;
+	long fit = (st.st_size - WTHOR_HEADER_SIZE) / WTHOR_GAME_SIZE;
+	if (fit < numGames) {
+		fprintf(stderr, "%s is cut short: %ld of %ld games\n", file, fit, numGames);
+		numGames = fit;
+	}
+
+	// Blocks of games are shared out between the threads and their
+	// positions written in order before the next block starts
+	const long SHARE = 1 << 14;
+	std::vector<std::vector<PositionRecord> > parts(threads);
+	std::vector<ImportStats> stats(threads);
+	const uint8_t *games = data + WTHOR_HEADER_SIZE;
+	for (long b = 0; b < numGames; b += SHARE*threads) {
+		std::vector<std::thread> workers;
+		for (int t = 0; t < threads; t++) {
+			long from = b + t*SHARE, to = from + SHARE;
+			if (from > numGames) from = numGames;
+			if (to > numGames) to = numGames;
+			workers.push_back(std::thread(replayGames, games + from*WTHOR_GAME_SIZE, to - from, theoryDepth,
+				&parts[t], &stats[t]));
+		}
+		for (int t = 0; t < threads; t++) {
+			workers[t].join();
+			fwrite(parts[t].data(), sizeof(PositionRecord), parts[t].size(), out);
+			total->add(stats[t]);
+		}
+	}
+	munmap(map, st.st_size);
+	return true;
+}
+
+static void usage(const char *name) {
+	fprintf(stderr, "usage: %s positions.bin games.wtb... [--threads N]\n", name);
+	exit(-1);
+}
+
+int main(int argc, char *argv[]) {
+	if (argc < 3) usage(argv[0]);
+	int threads = std::thread::hardware_concurrency();
+	std::vector<const char *> files;
+	for (int i = 2; i < argc; i++) {
+		if (!strcmp(argv[i], "--threads")) {
+			if (i + 1 >= argc) usage(argv[0]);
+			threads = atoi(argv[++i]);
+		}
+		else files.push_back(argv[i]);
+	}
+	if (threads < 1) threads = 1;
+	if (files.empty()) usage(argv[0]);
+
+	FILE *out = fopen(argv[1], "wb");
+	if (out == NULL) {
+		fprintf(stderr, "cannot open %s\n", argv[1]);
+		return 1;
+	}
+	static char buffer[1 << 20];
+	setvbuf(out, buffer, _IOFBF, sizeof(buffer));
+
+	ImportStats total;
+	memset(&total, 0, sizeof(total));
+	int failed = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (size_t f = 0; f < files.size(); f++) {
+		if (!importFile(files[f], out, threads, &total)) failed++;
+	}
+	if (fclose(out) != 0) {
+		fprintf(stderr, "cannot write %s\n", argv[1]);
+		return 1;
+	}
+	std::chrono::duration<double> spent = std::chrono::steady_clock::now() - start;
+	printf("%d files, %ld games, %ld corrupt games skipped, %ld positions written, %ld with a theoretical score\n",
+		(int) files.size() - failed, total.games, total.corrupt, total.positions, total.scored);
+	if (total.mismatched > 0) printf("%ld games finished with a different score than recorded\n", total.mismatched);
+	printf("%.2f seconds, %.0f games/s\n", spent.count(), total.games / spent.count());
+	return failed ? 1 : 0;
+}
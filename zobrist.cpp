@@ -0,0 +1,78 @@
+#include "zobrist.h"
+#include "symmetry.h"
+
+// The random keys, filled in once at startup
+static uint64_t squareKeys[2][64];
+static uint64_t blackToMoveKey;
+// The key each square and colour has once moved by each symmetry
+static uint64_t symmetricKeys[2][64][NUM_SYMMETRIES];
+
+/*
+ * splitmix64, used only to generate the keys. A hand written generator is
+ * used rather than <random> so the keys can never change between compilers.
+ */
+static uint64_t nextKey(uint64_t &state) {
+	uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+struct ZobristInit {
+	ZobristInit() {
+		uint64_t state = 0x45657965ULL;
+		for (int c = 0; c < 2; c++) {
+			for (int i = 0; i < 64; i++) squareKeys[c][i] = nextKey(state);
+		}
+		blackToMoveKey = nextKey(state);
+		for (int c = 0; c < 2; c++) {
+			for (int i = 0; i < 64; i++) {
+				for (int s = 0; s < NUM_SYMMETRIES; s++)
+					symmetricKeys[c][i][s] = squareKeys[c][transformSquare(i, s)];
+			}
+		}
+	}
+};
+static ZobristInit zobristInit;
+
+/*
+ * Hashes a position given the bitboards of black and white stones and the
+ * side that is about to move.
+ */
+uint64_t zobristHash(uint64_t black, uint64_t white, Side toMove) {
+	uint64_t h = (toMove == BLACK) ? blackToMoveKey : 0;
+	while (black) {
+		h ^= squareKeys[0][__builtin_ctzll(black)];
+		black &= black - 1;
+	}
+	while (white) {
+		h ^= squareKeys[1][__builtin_ctzll(white)];
+		white &= white - 1;
+	}
+	return h;
+}
+
+/*
+ * All eight keys are made in one pass over the stones, from the keys the
+ * squares take under each symmetry, rather than by moving the stones.
+ */
+uint64_t canonicalZobristHash(uint64_t black, uint64_t white, Side toMove, int *symmetry) {
+	uint64_t h[NUM_SYMMETRIES];
+	for (int s = 0; s < NUM_SYMMETRIES; s++) h[s] = (toMove == BLACK) ? blackToMoveKey : 0;
+	while (black) {
+		const uint64_t *keys = symmetricKeys[0][__builtin_ctzll(black)];
+		for (int s = 0; s < NUM_SYMMETRIES; s++) h[s] ^= keys[s];
+		black &= black - 1;
+	}
+	while (white) {
+		const uint64_t *keys = symmetricKeys[1][__builtin_ctzll(white)];
+		for (int s = 0; s < NUM_SYMMETRIES; s++) h[s] ^= keys[s];
+		white &= white - 1;
+	}
+	int best = 0;
+	for (int s = 1; s < NUM_SYMMETRIES; s++) {
+		if (h[s] < h[best]) best = s;
+	}
+	*symmetry = best;
+	return h[best];
+}
@@ -0,0 +1,21 @@
+#ifndef __ZOBRIST_H__
+#define __ZOBRIST_H__
+
+#include <cstdint>
+#include "common.h"
+
+/*
+ * Zobrist keys for every (square, colour) pair plus one for the side to
+ * move. They come from a fixed seed, so every process (and every run)
+ * agrees on them, which is what lets keys be saved to disk.
+ */
+uint64_t zobristHash(uint64_t black, uint64_t white, Side toMove);
+
+/*
+ * The smallest key of the position under the eight symmetries of the
+ * board, so every orientation of it gets the same key, and in symmetry the
+ * one (see symmetry.h) that turns the position into the one with that key.
+ */
+uint64_t canonicalZobristHash(uint64_t black, uint64_t white, Side toMove, int *symmetry);
+
+#endif